@@ -0,0 +1,152 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <bit>
+
+// Area moves are compound moves made of a jump and then another jump, which can capture on both steps: the lion-like pieces' moves, and the free eagle's capturing and returning.
+// They never reach further than the 5x5 area around the piece, so rather than going through the board bitsets for every step, they're generated from 25-bit masks of that area.
+// Bit (dy + 2) * 5 + dx + 2 of an area mask is the square offset by (dx, dy) from the piece, so going through the bits in order goes through the squares in board order.
+// This file relies on movementTables, movementDirToBoardDir and BoardPosBitset from tomatene.cpp.
+
+inline constexpr uint8_t AREA_CENTER_BIT = 12;
+inline constexpr size_t MAX_AREA_MOVE_FIRST_STEPS = 8;
+
+struct AreaMove {
+	uint8_t firstStepCount = 0;
+	// the area bit of each first step, already flipped for the owner
+	std::array<uint8_t, MAX_AREA_MOVE_FIRST_STEPS> firstStepBits{};
+	// the area bits the second step can land on after each first step
+	std::array<uint32_t, MAX_AREA_MOVE_FIRST_STEPS> secondStepAreas{};
+};
+
+inline constexpr uint8_t toAreaBit(Vec2 offset) {
+	return (offset.y + 2) * 5 + offset.x + 2;
+}
+inline constexpr Vec2 fromAreaBit(uint8_t bit) {
+	return { static_cast<int8_t>(bit % 5 - 2), static_cast<int8_t>(bit / 5 - 2) };
+}
+
+struct AreaMoveTables {
+	// [compound move], indexing movementTables.compoundMoves
+	std::array<bool, MovementTablesGeneration::SIZES.compoundMoves> isAreaMove{};
+	// [compound move][owner]
+	std::array<std::array<AreaMove, 2>, MovementTablesGeneration::SIZES.compoundMoves> areaMoves{};
+	std::array<bool, 302> hasAreaMoves{};
+	// the squares of each square's area that are off the board
+	std::array<uint32_t, 1296> offBoardAreas{};
+};
+
+namespace AreaMoveTablesGeneration {
+	consteval bool isWithinArea(Vec2 offset) {
+		return offset.x >= -2 && offset.x <= 2 && offset.y >= -2 && offset.y <= 2;
+	}
+	consteval AreaMoveTables generate() {
+		AreaMoveTables tables;
+		for(size_t species = 0; species < 302; species++) {
+			MovementSpan compoundMoveSpan = movementTables.compoundMoveSpans[species];
+			for(size_t compoundMoveI = compoundMoveSpan.offset; compoundMoveI < compoundMoveSpan.offset + compoundMoveSpan.count; compoundMoveI++) {
+				const FlatCompoundMove &compoundMove = movementTables.compoundMoves[compoundMoveI];
+				if(!compoundMove.canContinueAfterCapture || compoundMove.firstStepSlides.count || compoundMove.secondStepSlides.count || compoundMove.firstStepJumps.count > MAX_AREA_MOVE_FIRST_STEPS) {
+					continue;
+				}
+				bool fitsInArea = true;
+				for(Vec2 firstStepJump : movementTables.getJumps(compoundMove.firstStepJumps)) {
+					for(Vec2 secondStepJump : movementTables.getJumps(compoundMove.secondStepJumps)) {
+						fitsInArea = fitsInArea && isWithinArea(firstStepJump) && isWithinArea(firstStepJump + secondStepJump);
+					}
+				}
+				if(!fitsInArea) {
+					continue;
+				}
+				tables.isAreaMove[compoundMoveI] = true;
+				tables.hasAreaMoves[species] = true;
+				for(uint8_t owner = 0; owner < 2; owner++) {
+					AreaMove &areaMove = tables.areaMoves[compoundMoveI][owner];
+					for(Vec2 firstStepJump : movementTables.getJumps(compoundMove.firstStepJumps)) {
+						Vec2 firstStep = movementDirToBoardDir(firstStepJump, owner);
+						uint32_t secondStepArea = 0;
+						for(Vec2 secondStepJump : movementTables.getJumps(compoundMove.secondStepJumps)) {
+							secondStepArea |= 1u << toAreaBit(firstStep + movementDirToBoardDir(secondStepJump, owner));
+						}
+						areaMove.firstStepBits[areaMove.firstStepCount] = toAreaBit(firstStep);
+						areaMove.secondStepAreas[areaMove.firstStepCount] = secondStepArea;
+						areaMove.firstStepCount++;
+					}
+				}
+			}
+		}
+		for(size_t i = 0; i < 1296; i++) {
+			Vec2 pos = Vec2::fromIndex(i);
+			for(uint8_t bit = 0; bit < 25; bit++) {
+				if(!isPosWithinBounds(pos + fromAreaBit(bit))) {
+					tables.offBoardAreas[i] |= 1u << bit;
+				}
+			}
+		}
+		return tables;
+	}
+}
+
+inline constexpr AreaMoveTables areaMoveTables = AreaMoveTablesGeneration::generate();
+
+// Where a piece's area moves can go: for each first step, the area bits the second step can land on. First steps with nowhere to go are left out.
+// A piece's area moves together never have more first steps than a single area move can.
+struct AreaMoveDestinations {
+	uint8_t count = 0;
+	std::array<uint8_t, MAX_AREA_MOVE_FIRST_STEPS> firstStepBits{};
+	std::array<uint32_t, MAX_AREA_MOVE_FIRST_STEPS> secondStepAreas{};
+};
+static_assert([] {
+	for(size_t species = 0; species < 302; species++) {
+		size_t firstStepCount = 0;
+		MovementSpan compoundMoveSpan = movementTables.compoundMoveSpans[species];
+		for(size_t compoundMoveI = compoundMoveSpan.offset; compoundMoveI < compoundMoveSpan.offset + compoundMoveSpan.count; compoundMoveI++) {
+			if(areaMoveTables.isAreaMove[compoundMoveI]) {
+				firstStepCount += areaMoveTables.areaMoves[compoundMoveI][0].firstStepCount;
+			}
+		}
+		if(firstStepCount > MAX_AREA_MOVE_FIRST_STEPS) {
+			return false;
+		}
+	}
+	return true;
+}(), "A species has too many area move first steps for AreaMoveDestinations");
+// Moves are only stored with their middle step for area moves, so any other compound moves mustn't be able to capture on their first step
+static_assert([] {
+	for(size_t compoundMoveI = 0; compoundMoveI < movementTables.compoundMoves.size(); compoundMoveI++) {
+		if(movementTables.compoundMoves[compoundMoveI].canContinueAfterCapture && !areaMoveTables.isAreaMove[compoundMoveI]) {
+			return false;
+		}
+	}
+	return true;
+}(), "A compound move which can capture on its first step isn't an area move");
+
+// Gets the area around center from a bitset. Squares that are off the board can be anything.
+inline uint32_t getArea(const BoardPosBitset &bitset, Vec2 center) {
+	uint32_t area = 0;
+	for(int8_t dy = -2; dy <= 2; dy++) {
+		int8_t y = center.y + dy;
+		if(y < 0 || y > 35) {
+			continue;
+		}
+		int rowStartI = y * 36 + center.x - 2;
+		uint32_t row = rowStartI < 0? bitset.getBits(0, 5) << -rowStartI : bitset.getBits(rowStartI, 5);
+		area |= (row & 0b11111) << (dy + 2) * 5;
+	}
+	return area;
+}
+// Inserts the area around center into a bitset. It mustn't have any squares that are off the board.
+inline void insertArea(BoardPosBitset &bitset, Vec2 center, uint32_t area) {
+	for(int8_t dy = -2; dy <= 2; dy++) {
+		uint32_t row = (area >> (dy + 2) * 5) & 0b11111;
+		if(!row) {
+			continue;
+		}
+		int rowStartI = (center.y + dy) * 36 + center.x - 2;
+		if(rowStartI < 0) {
+			bitset.insertBits(0, row >> -rowStartI);
+		} else {
+			bitset.insertBits(rowStartI, row);
+		}
+	}
+}
@@ -3,13 +3,148 @@
 #include <cstdint>
 #include <vector>
 #include <bit>
+#include <concepts>
+#include <algorithm>
 #include <immintrin.h>
 
 // A bitset for storing board positions.
 class BoardPosBitset {
 private:
-	alignas(64) std::array<uint64_t, 21> words{};
+	// 1296 squares only need 21 words, but it's padded to 24 so that the vectorised operations work on whole registers without a tail. The padding words are always 0.
+	// alignas(64) rounded it up to 192 bytes anyway, so the padding doesn't take any more memory.
+	static constexpr size_t WORD_COUNT = 24;
+	static constexpr size_t USED_WORD_COUNT = 21;
+	alignas(64) std::array<uint64_t, WORD_COUNT> words{};
+	
+	// Sets every word to op(the same word of each of sources). This bitset can be one of the sources. op has to keep the padding words 0, i.e. op(0, ...) == 0.
+	template <typename F, std::same_as<BoardPosBitset>... Sources>
+	constexpr void setWords(F &&op, const Sources &...sources) {
+		#ifdef __AVX512F__
+			// 3 AVX-512 registers
+			for(size_t i = 0; i < WORD_COUNT; i += 8) {
+				_mm512_store_si512(&words[i], op(_mm512_load_si512(&sources.words[i])...));
+			}
+		#elif defined(__AVX2__)
+			// 6 AVX registers
+			for(size_t i = 0; i < WORD_COUNT; i += 4) {
+				_mm256_store_si256(reinterpret_cast<__m256i*>(&words[i]), op(_mm256_load_si256(reinterpret_cast<const __m256i*>(&sources.words[i]))...));
+			}
+		#else
+			for(size_t i = 0; i < USED_WORD_COUNT; i++) {
+				words[i] = op(sources.words[i]...);
+			}
+		#endif
+	}
+	// Whether op(word, the same word of each of others) is 0 for every word, without storing anything
+	template <typename F, std::same_as<BoardPosBitset>... Others>
+	constexpr bool isEmptyAfter(F &&op, const Others &...others) const {
+		#ifdef __AVX512F__
+			__m512i combined = _mm512_setzero_si512();
+			for(size_t i = 0; i < WORD_COUNT; i += 8) {
+				combined = _mm512_or_si512(combined, op(_mm512_load_si512(&words[i]), _mm512_load_si512(&others.words[i])...));
+			}
+			return !_mm512_test_epi64_mask(combined, combined);
+		#elif defined(__AVX2__)
+			__m256i combined = _mm256_setzero_si256();
+			for(size_t i = 0; i < WORD_COUNT; i += 4) {
+				combined = _mm256_or_si256(combined, op(_mm256_load_si256(reinterpret_cast<const __m256i*>(&words[i])), _mm256_load_si256(reinterpret_cast<const __m256i*>(&others.words[i]))...));
+			}
+			return _mm256_testz_si256(combined, combined);
+		#else
+			uint64_t combined = 0;
+			for(size_t i = 0; i < USED_WORD_COUNT; i++) {
+				combined |= op(words[i], others.words[i]...);
+			}
+			return !combined;
+		#endif
+	}
+	#ifdef __AVX512F__
+		// the unmasked versions of some intrinsics set GCC 12 off warning about the undefined register they merge into, so these use the zero-masking versions with every lane kept
+		static constexpr __mmask8 ALL_LANES = 0xFF;
+		// Register i of the words moved up by wordShift words (or down for negative wordShift), filling in with 0s
+		template <int wordShift>
+		static __m512i shiftRegisterWords(const __m512i (&registers)[3], size_t i) {
+			// word j of the result is word j - wordShift of the input, which is word lowWordI of register lowRegisterI or the ones after it
+			constexpr int lowRegisterI = -wordShift >= 0? -wordShift / 8 : (-wordShift - 7) / 8;
+			constexpr int lowWordI = -wordShift - lowRegisterI * 8;
+			auto getRegister = [&](int registerI) {
+				return registerI >= 0 && registerI < 3? registers[registerI] : _mm512_setzero_si512();
+			};
+			if constexpr(lowWordI == 0) {
+				return getRegister(static_cast<int>(i) + lowRegisterI);
+			} else {
+				return _mm512_maskz_alignr_epi64(ALL_LANES, getRegister(static_cast<int>(i) + lowRegisterI + 1), getRegister(static_cast<int>(i) + lowRegisterI), lowWordI);
+			}
+		}
+		// For expandInto: writes wordValues[i] | orValue for every bit i in word, a run of 16 bits at a time, skipping the empty runs
+		static uint32_t *compressWordInto(uint32_t *dest, const uint32_t *wordValues, uint64_t word, uint32_t orValue) {
+			__m512i orValues = _mm512_set1_epi32(orValue);
+			while(word) {
+				size_t runOffset = std::countr_zero(word) & ~15;
+				__mmask16 run = static_cast<__mmask16>(word >> runOffset);
+				__m512i runValues = _mm512_or_si512(_mm512_loadu_si512(wordValues + runOffset), orValues);
+				_mm512_storeu_si512(dest, _mm512_maskz_compress_epi32(run, runValues));
+				dest += std::popcount(run);
+				word &= ~(0xFFFFULL << runOffset);
+			}
+			return dest;
+		}
+	#elif defined(__AVX2__)
+		// The same for the 6 AVX registers
+		template <int wordShift>
+		static __m256i shiftRegisterWords(const __m256i (&registers)[6], size_t i) {
+			constexpr int lowRegisterI = -wordShift >= 0? -wordShift / 4 : (-wordShift - 3) / 4;
+			constexpr int lowWordI = -wordShift - lowRegisterI * 4;
+			auto getRegister = [&](int registerI) {
+				return registerI >= 0 && registerI < 6? registers[registerI] : _mm256_setzero_si256();
+			};
+			__m256i low = getRegister(static_cast<int>(i) + lowRegisterI);
+			__m256i high = getRegister(static_cast<int>(i) + lowRegisterI + 1);
+			// AVX2 can only shift bytes within each 128-bit lane, so this gets the 128 bits in between the lanes first
+			__m256i middle = _mm256_permute2x128_si256(low, high, 0x21);
+			if constexpr(lowWordI == 0) {
+				return low;
+			} else if constexpr(lowWordI == 1) {
+				return _mm256_alignr_epi8(middle, low, 8);
+			} else if constexpr(lowWordI == 2) {
+				return middle;
+			} else {
+				return _mm256_alignr_epi8(high, middle, 8);
+			}
+		}
+		// [bits]: the lanes of the bits that are set, in order, a byte each, for moving them to the front of a register with _mm256_permutevar8x32_epi32
+		static constexpr std::array<uint64_t, 256> COMPRESS_PERMUTATIONS = [] {
+			std::array<uint64_t, 256> permutations{};
+			for(size_t bits = 0; bits < 256; bits++) {
+				size_t laneCount = 0;
+				for(uint64_t lane = 0; lane < 8; lane++) {
+					if(bits >> lane & 1) {
+						permutations[bits] |= lane << (laneCount++ * 8);
+					}
+				}
+			}
+			return permutations;
+		}();
+		// The same as the AVX-512 version, but 8 bits at a time, and AVX2 has no compress, so the set bits' lanes get shuffled to the front with a permutation looked up from the run's bits instead
+		static uint32_t *compressWordInto(uint32_t *dest, const uint32_t *wordValues, uint64_t word, uint32_t orValue) {
+			__m256i orValues = _mm256_set1_epi32(orValue);
+			while(word) {
+				size_t runOffset = std::countr_zero(word) & ~7;
+				uint8_t run = static_cast<uint8_t>(word >> runOffset);
+				__m256i runValues = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(wordValues + runOffset)), orValues);
+				__m256i permutation = _mm256_cvtepu8_epi32(_mm_cvtsi64_si128(COMPRESS_PERMUTATIONS[run]));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), _mm256_permutevar8x32_epi32(runValues, permutation));
+				dest += std::popcount(run);
+				word &= ~(0xFFULL << runOffset);
+			}
+			return dest;
+		}
+	#endif
 public:
+	// a value for every index expandInto could look at, including the padding words'
+	using ExpansionValues = std::array<uint32_t, WORD_COUNT * 64>;
+	static constexpr size_t EXPANSION_SLACK = 16;
+	
 	constexpr void insert(const Vec2 pos) {
 		size_t i = pos.toIndex();
 		insert(i);
@@ -35,78 +170,229 @@ public:
 		words.fill(0);
 	}
 	constexpr size_t size() const {
-		size_t count = 0;
-		for(uint64_t word : words) {
-			count += std::popcount(word);
-		}
-		return count;
+		#ifdef __AVX512VPOPCNTDQ__
+			__m512i counts = _mm512_setzero_si512();
+			for(size_t i = 0; i < WORD_COUNT; i += 8) {
+				counts = _mm512_add_epi64(counts, _mm512_popcnt_epi64(_mm512_load_si512(&words[i])));
+			}
+			// summed through the vector extension rather than _mm512_reduce_add_epi64, which GCC 12 warns about because it extracts into an undefined register
+			size_t count = 0;
+			for(size_t i = 0; i < 8; i++) {
+				count += counts[i];
+			}
+			return count;
+		#elif defined(__AVX2__)
+			// Harley-Seal's carry-save adders only pay off over many more registers than 6, so this is just its inner popcount: looking up each nibble's count with a shuffle, then summing the bytes with sad
+			const __m256i nibbleCounts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+			const __m256i lowNibbles = _mm256_set1_epi8(0x0F);
+			__m256i byteCounts = _mm256_setzero_si256();
+			for(size_t i = 0; i < WORD_COUNT; i += 4) {
+				__m256i word = _mm256_load_si256(reinterpret_cast<const __m256i*>(&words[i]));
+				__m256i lowCounts = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(word, lowNibbles));
+				__m256i highCounts = _mm256_shuffle_epi8(nibbleCounts, _mm256_and_si256(_mm256_srli_epi16(word, 4), lowNibbles));
+				// at most 6 * 8 = 48 per byte, so this can't overflow
+				byteCounts = _mm256_add_epi8(byteCounts, _mm256_add_epi8(lowCounts, highCounts));
+			}
+			__m256i counts = _mm256_sad_epu8(byteCounts, _mm256_setzero_si256());
+			return _mm256_extract_epi64(counts, 0) + _mm256_extract_epi64(counts, 1) + _mm256_extract_epi64(counts, 2) + _mm256_extract_epi64(counts, 3);
+		#else
+			size_t count = 0;
+			for(size_t i = 0; i < USED_WORD_COUNT; i++) {
+				count += std::popcount(words[i]);
+			}
+			return count;
+		#endif
+	}
+	constexpr bool isEmpty() const {
+		return isEmptyAfter([](auto word) {
+			return word;
+		});
+	}
+	constexpr bool operator==(const BoardPosBitset &other) const {
+		return isEmptyAfter([](auto word, auto otherWord) {
+			return word ^ otherWord;
+		}, other);
 	}
 	
+	// The word-wise operations below are all written as lambdas which GCC and Clang's vector extensions let work on __m512i, __m256i and uint64_t alike
 	constexpr BoardPosBitset& operator|=(const BoardPosBitset &other) noexcept {
-		uint64_t* thisWords = words.data();
-		const uint64_t* otherWords = other.words.data();
+		setWords([](auto word, auto otherWord) {
+			return word | otherWord;
+		}, *this, other);
+		return *this;
+	}
+	constexpr BoardPosBitset& operator&=(const BoardPosBitset &other) noexcept {
+		setWords([](auto word, auto otherWord) {
+			return word & otherWord;
+		}, *this, other);
+		return *this;
+	}
+	constexpr BoardPosBitset& operator^=(const BoardPosBitset &other) noexcept {
+		setWords([](auto word, auto otherWord) {
+			return word ^ otherWord;
+		}, *this, other);
+		return *this;
+	}
+	constexpr BoardPosBitset operator|(const BoardPosBitset &other) const noexcept {
+		BoardPosBitset res;
+		res.setWords([](auto word, auto otherWord) {
+			return word | otherWord;
+		}, *this, other);
+		return res;
+	}
+	constexpr BoardPosBitset operator&(const BoardPosBitset &other) const noexcept {
+		BoardPosBitset res;
+		res.setWords([](auto word, auto otherWord) {
+			return word & otherWord;
+		}, *this, other);
+		return res;
+	}
+	constexpr BoardPosBitset operator^(const BoardPosBitset &other) const noexcept {
+		BoardPosBitset res;
+		res.setWords([](auto word, auto otherWord) {
+			return word ^ otherWord;
+		}, *this, other);
+		return res;
+	}
+	// Erases everything in other, i.e. *this &= ~other
+	constexpr void eraseAll(const BoardPosBitset &other) noexcept {
+		setWords([](auto word, auto otherWord) {
+			return word & ~otherWord;
+		}, *this, other);
+	}
+	// Inserts everything in other that isn't in excluded, i.e. *this |= other & ~excluded
+	constexpr void insertAllExcept(const BoardPosBitset &other, const BoardPosBitset &excluded) noexcept {
+		// this becomes a single vpternlogq with AVX-512
+		setWords([](auto word, auto otherWord, auto excludedWord) {
+			return word | (otherWord & ~excludedWord);
+		}, *this, other, excluded);
+	}
+	
+	// Moves every index i to i + offset, dropping the ones that go past either end of the board. Nothing stops indices wrapping around from the end of one rank to the start of another, so that's up to the caller.
+	template <int offset>
+	constexpr BoardPosBitset shifted() const {
+		// the offset being known at compile time means every word of the result is a funnel shift of two fixed words, with the ones off the end known to be 0
+		constexpr size_t wordOffset = (offset >= 0? offset : -offset) >> 6;
+		constexpr size_t bitOffset = (offset >= 0? offset : -offset) & 63;
+		BoardPosBitset res;
 		#ifdef __AVX512F__
-			// Two AVX-512 registers + 1 AVX register + 1 regular register
-			for(int i = 0; i < 2; i++) {
-				uint64_t* thisWordAdr = thisWords + i * 8;
-				__m512i thisWord = _mm512_load_si512(thisWordAdr);
-				const uint64_t* otherWordAdr = otherWords + i * 8;
-				__m512i otherWord = _mm512_load_si512(otherWordAdr);
-				__m512i res = _mm512_or_si512(thisWord, otherWord);
-				_mm512_store_si512(thisWordAdr, res);
-			}
-			
-			__m256i* thisWordAdr = reinterpret_cast<__m256i*>(thisWords + 16);
-			__m256i thisWord = _mm256_load_si256(thisWordAdr);
-			const __m256i* otherWordAdr = reinterpret_cast<const __m256i*>(otherWords + 16);
-			__m256i otherWord = _mm256_load_si256(otherWordAdr);
-			__m256i res = _mm256_or_si256(thisWord, otherWord);
-			_mm256_store_si256(thisWordAdr, res);
-			
-			words[20] |= other.words[20];
+			// done in the same registers as everything else, since storing it a word or half a register at a time stops the next operation's loads being forwarded from the stores
+			__m512i registers[3];
+			for(size_t i = 0; i < 3; i++) {
+				registers[i] = _mm512_load_si512(&words[i * 8]);
+			}
+			constexpr int wordShift = offset >= 0? static_cast<int>(wordOffset) : -static_cast<int>(wordOffset);
+			constexpr int carryWordShift = offset >= 0? wordShift + 1 : wordShift - 1;
+			for(size_t i = 0; i < 3; i++) {
+				__m512i shiftedWords = shiftRegisterWords<wordShift>(registers, i);
+				__m512i carryWords = shiftRegisterWords<carryWordShift>(registers, i);
+				__m512i resRegister;
+				if constexpr(!bitOffset) {
+					resRegister = shiftedWords;
+				} else if constexpr(offset >= 0) {
+					resRegister = _mm512_or_si512(_mm512_maskz_slli_epi64(ALL_LANES, shiftedWords, bitOffset), _mm512_maskz_srli_epi64(ALL_LANES, carryWords, 64 - bitOffset));
+				} else {
+					resRegister = _mm512_or_si512(_mm512_maskz_srli_epi64(ALL_LANES, shiftedWords, bitOffset), _mm512_maskz_slli_epi64(ALL_LANES, carryWords, 64 - bitOffset));
+				}
+				if constexpr(offset > 0) {
+					if(i == 2) {
+						// 1296 = 20 * 64 + 16
+						resRegister = _mm512_and_si512(resRegister, _mm512_setr_epi64(-1, -1, -1, -1, (1LL << 16) - 1, 0, 0, 0));
+					}
+				}
+				_mm512_store_si512(&res.words[i * 8], resRegister);
+			}
 		#elif defined(__AVX2__)
-			// 5 AVX registers + 1 regular register
-			for(int i = 0; i < 5; i++) {
-				__m256i* thisWordAdr = reinterpret_cast<__m256i*>(thisWords + i * 4);
-				__m256i thisWord = _mm256_load_si256(thisWordAdr);
-				const __m256i* otherWordAdr = reinterpret_cast<const __m256i*>(otherWords + i * 4);
-				__m256i otherWord = _mm256_load_si256(otherWordAdr);
-				__m256i res = _mm256_or_si256(thisWord, otherWord);
-				_mm256_store_si256(thisWordAdr, res);
-			}
-			
-			words[20] |= other.words[20];
+			__m256i registers[6];
+			for(size_t i = 0; i < 6; i++) {
+				registers[i] = _mm256_load_si256(reinterpret_cast<const __m256i*>(&words[i * 4]));
+			}
+			constexpr int wordShift = offset >= 0? static_cast<int>(wordOffset) : -static_cast<int>(wordOffset);
+			constexpr int carryWordShift = offset >= 0? wordShift + 1 : wordShift - 1;
+			for(size_t i = 0; i < 6; i++) {
+				__m256i shiftedWords = shiftRegisterWords<wordShift>(registers, i);
+				__m256i carryWords = shiftRegisterWords<carryWordShift>(registers, i);
+				__m256i resRegister;
+				if constexpr(!bitOffset) {
+					resRegister = shiftedWords;
+				} else if constexpr(offset >= 0) {
+					resRegister = _mm256_or_si256(_mm256_slli_epi64(shiftedWords, bitOffset), _mm256_srli_epi64(carryWords, 64 - bitOffset));
+				} else {
+					resRegister = _mm256_or_si256(_mm256_srli_epi64(shiftedWords, bitOffset), _mm256_slli_epi64(carryWords, 64 - bitOffset));
+				}
+				if constexpr(offset > 0) {
+					if(i == 5) {
+						resRegister = _mm256_and_si256(resRegister, _mm256_setr_epi64x((1LL << 16) - 1, 0, 0, 0));
+					}
+				}
+				_mm256_store_si256(reinterpret_cast<__m256i*>(&res.words[i * 4]), resRegister);
+			}
 		#else
-			for(size_t i = 0; i < 21; i++) {
-				words[i] |= other.words[i];
+			for(size_t i = 0; i < WORD_COUNT; i++) {
+				if constexpr(offset >= 0) {
+					uint64_t word = i >= wordOffset? words[i - wordOffset] : 0;
+					uint64_t lowerWord = i >= wordOffset + 1? words[i - wordOffset - 1] : 0;
+					res.words[i] = word << bitOffset | (bitOffset? lowerWord >> (64 - bitOffset) % 64 : 0);
+				} else {
+					uint64_t word = i + wordOffset < WORD_COUNT? words[i + wordOffset] : 0;
+					uint64_t higherWord = i + wordOffset + 1 < WORD_COUNT? words[i + wordOffset + 1] : 0;
+					res.words[i] = word >> bitOffset | (bitOffset? higherWord << (64 - bitOffset) % 64 : 0);
+				}
+			}
+			if constexpr(offset > 0) {
+				// 1296 = 20 * 64 + 16
+				res.words[20] &= (1ULL << 16) - 1;
+				std::fill(res.words.begin() + USED_WORD_COUNT, res.words.end(), 0);
 			}
 		#endif
-		return *this;
+		return res;
 	}
 	
-	template <typename T, std::invocable<Vec2> F>
-	requires std::convertible_to<std::invoke_result_t<F, Vec2>, T>
-	constexpr void transformInto(std::vector<T> &dest, F &&transformFunction) const {
-		dest.reserve(dest.size() + size());
-		size_t wordIndex = 0;
-		for(uint64_t word : words) {
-			while(word) {
-				auto bitOffset = std::countr_zero(word);
-				size_t index = (wordIndex << 6) + bitOffset;
-				dest.push_back(transformFunction(Vec2::fromIndex(index)));
-				
-				// remove the trailing bit
-				word &= word - 1;
+	// Gets the bits for the indices [i, i + count), for count < 64
+	constexpr uint64_t getBits(size_t i, size_t count) const {
+		size_t wordIndex = i >> 6;
+		size_t bitOffset = i & 63;
+		uint64_t bits = words[wordIndex] >> bitOffset;
+		if(bitOffset + count > 64) {
+			bits |= words[wordIndex + 1] << (64 - bitOffset);
+		}
+		return bits & ((1ULL << count) - 1);
+	}
+	// Inserts the indices i + n for every set bit n of bits. They mustn't go past the end of the board.
+	constexpr void insertBits(size_t i, uint64_t bits) {
+		size_t wordIndex = i >> 6;
+		size_t bitOffset = i & 63;
+		words[wordIndex] |= bits << bitOffset;
+		if(bitOffset && bits >> (64 - bitOffset)) {
+			words[wordIndex + 1] |= bits >> (64 - bitOffset);
+		}
+	}
+	
+	// Writes values[i] | orValue to dest for every index i in the words in wordMask (which must include every non-empty word), in order, and returns the end of what it wrote.
+	// With SIMD, words with more than a few indices in them are done 16 (AVX-512) or 8 (AVX2) indices at a time by compressing their values together and writing a whole register, so dest needs room for EXPANSION_SLACK more values past the end.
+	// A compress costs about as much as writing 4 values one at a time, and most pieces only have a move or two in each word, so sparse words are still done one at a time.
+	uint32_t *expandInto(uint32_t *dest, const ExpansionValues &values, uint32_t orValue, uint32_t wordMask) const {
+		for(; wordMask; wordMask &= wordMask - 1) {
+			size_t wordIndex = std::countr_zero(wordMask);
+			const uint32_t *wordValues = &values[wordIndex << 6];
+			uint64_t word = words[wordIndex];
+			#if defined(__AVX512F__) || defined(__AVX2__)
+				if(std::popcount(word) > 4) {
+					dest = compressWordInto(dest, wordValues, word, orValue);
+					continue;
+				}
+			#endif
+			for(; word; word &= word - 1) {
+				*dest++ = wordValues[std::countr_zero(word)] | orValue;
 			}
-			wordIndex++;
 		}
+		return dest;
 	}
 	template <std::invocable<uint64_t, uint64_t> F, std::invocable<size_t> J>
 	requires std::convertible_to<std::invoke_result_t<F, uint64_t, uint64_t>, uint64_t>
 	constexpr void bitTransformForEach(const BoardPosBitset &other, F &&bitTransformFunction, J &&forEachFunction) const {
-		size_t wordIndex = 0;
-		for(uint64_t word : words) {
-			word = bitTransformFunction(word, other.words[wordIndex]);
+		for(size_t wordIndex = 0; wordIndex < USED_WORD_COUNT; wordIndex++) {
+			uint64_t word = bitTransformFunction(words[wordIndex], other.words[wordIndex]);
 			while(word) {
 				auto bitOffset = std::countr_zero(word);
 				size_t index = (wordIndex << 6) + bitOffset;
@@ -115,13 +401,12 @@ public:
 				// remove the trailing bit
 				word &= word - 1;
 			}
-			wordIndex++;
 		}
 	}
 	template <std::invocable<size_t> F>
 	constexpr void forEach(F &&forEachFunction) const {
-		size_t wordIndex = 0;
-		for(uint64_t word : words) {
+		for(size_t wordIndex = 0; wordIndex < USED_WORD_COUNT; wordIndex++) {
+			uint64_t word = words[wordIndex];
 			while(word) {
 				auto bitOffset = std::countr_zero(word);
 				size_t index = (wordIndex << 6) + bitOffset;
@@ -130,13 +415,40 @@ public:
 				// remove the trailing bit
 				word &= word - 1;
 			}
-			wordIndex++;
 		}
 	}
+	// Which words have anything in them, as a mask with a bit per word
+	constexpr uint32_t getNonEmptyWords() const {
+		#ifdef __AVX512F__
+			__m512i firstWords = _mm512_load_si512(&words[0]);
+			__m512i middleWords = _mm512_load_si512(&words[8]);
+			__m512i lastWords = _mm512_load_si512(&words[16]);
+			return _mm512_test_epi64_mask(firstWords, firstWords) | _mm512_test_epi64_mask(middleWords, middleWords) << 8 | _mm512_test_epi64_mask(lastWords, lastWords) << 16;
+		#else
+			uint32_t wordMask = 0;
+			for(size_t wordIndex = 0; wordIndex < USED_WORD_COUNT; wordIndex++) {
+				wordMask |= (words[wordIndex] != 0) << wordIndex;
+			}
+			return wordMask;
+		#endif
+	}
+	// Like size, but only counts the words in wordMask, which must include every non-empty word
+	constexpr size_t sizeInWords(uint32_t wordMask) const {
+		size_t count = 0;
+		while(wordMask) {
+			count += std::popcount(words[std::countr_zero(wordMask)]);
+			wordMask &= wordMask - 1;
+		}
+		return count;
+	}
+	// The bit for the word containing i, in a word mask like getNonEmptyWords'
+	static constexpr uint32_t getWordMask(const size_t i) {
+		return 1u << (i >> 6);
+	}
 	template <std::invocable<size_t> F>
 	constexpr void forEachAndClear(F &&forEachFunction) {
-		size_t wordIndex = 0;
-		for(uint64_t &word : words) {
+		for(size_t wordIndex = 0; wordIndex < USED_WORD_COUNT; wordIndex++) {
+			uint64_t &word = words[wordIndex];
 			while(word) {
 				auto bitOffset = std::countr_zero(word);
 				size_t index = (wordIndex << 6) + bitOffset;
@@ -145,7 +457,8 @@ public:
 				// remove the trailing bit
 				word &= word - 1;
 			}
-			wordIndex++;
 		}
 	}
-};
\ No newline at end of file
+};
+// the padding mustn't make it any bigger than the 3 cache lines it already took
+static_assert(sizeof(BoardPosBitset) == 192);
\ No newline at end of file
@@ -0,0 +1,130 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+// Set-wise slides: rather than walking each piece's rays a square at a time, every piece sliding the same way is slid at once by shifting whole bitsets, doubling how far they've got each time (Kogge-Stone style).
+// A step in direction dir adds dir.x + 36 * dir.y to a square's index. A sideways step off one edge of the board would wrap around onto the other edge of the next rank, so those squares get masked out, and steps off the top or bottom just drop off the end of the bitset.
+// This file relies on movementTables, movementDirToBoardDir, Vec2 and BoardPosBitset from tomatene.cpp.
+
+namespace FloodFill {
+	inline constexpr uint8_t MAX_SLIDE_RANGE = 35;
+	inline constexpr size_t MAX_SLIDE_GROUPS = 128;
+	
+	// [dir.x + 1]: the squares a step with that sideways direction can land on without having wrapped around. [1] is the whole board.
+	inline constexpr std::array<BoardPosBitset, 3> LANDABLE_SQUARES = [] {
+		std::array<BoardPosBitset, 3> squares;
+		for(size_t i = 0; i < 1296; i++) {
+			Vec2 pos = Vec2::fromIndex(i);
+			if(pos.x != 35) {
+				squares[0].insert(i);
+			}
+			squares[1].insert(i);
+			if(pos.x != 0) {
+				squares[2].insert(i);
+			}
+		}
+		return squares;
+	}();
+	inline constexpr const BoardPosBitset &ALL_SQUARES = LANDABLE_SQUARES[1];
+	
+	// Shifts reached along runs of runLength squares that can be slid through, doubling reach (to 2 * reach + 1, since runLength is always reach + 1), and carries on doubling.
+	// It stops before it would go past lastReach, except for full-length slides, where overshooting just goes off the board.
+	template <int offset, int runLength>
+	inline void doubleReach(BoardPosBitset &reached, const BoardPosBitset &runs, int &reach, int lastReach, bool isFullLength) {
+		if(reach >= lastReach || (reach + runLength > lastReach && !isFullLength)) {
+			return;
+		}
+		reached |= runs & reached.shifted<runLength * offset>();
+		reach += runLength;
+		if constexpr(runLength * 2 <= MAX_SLIDE_RANGE) {
+			doubleReach<offset, runLength * 2>(reached, runs & runs.shifted<runLength * offset>(), reach, lastReach, isFullLength);
+		}
+	}
+	// Every square the sliders attack sliding in (dx, dy) for up to range squares, where they can only slide through the passable squares. The square a slide stops on doesn't have to be passable, so with the empty squares as passable, these are the squares they attack.
+	// The direction is a template parameter so that all the shifts are by constant offsets.
+	template <int8_t dx, int8_t dy>
+	inline BoardPosBitset slideAttacks(const BoardPosBitset &sliders, const BoardPosBitset &passable, uint8_t range) {
+		constexpr int offset = dx + 36 * dy;
+		const BoardPosBitset &landable = LANDABLE_SQUARES[dx + 1];
+		// a slide can carry on through a square if it's passable and it's not where a step would have wrapped around to
+		const BoardPosBitset stepPassable = passable & landable;
+		// every square within reach steps of a slider through passable squares, which is all of them by the time reach is one less than the range
+		BoardPosBitset reached = sliders;
+		int reach = 0;
+		int lastReach = std::min(range, MAX_SLIDE_RANGE) - 1;
+		doubleReach<offset, 1>(reached, stepPassable, reach, lastReach, range >= MAX_SLIDE_RANGE);
+		// then single steps for the rest
+		for(; reach < lastReach; reach++) {
+			reached |= stepPassable & reached.shifted<offset>();
+		}
+		return reached.shifted<offset>() & landable;
+	}
+	inline BoardPosBitset slideAttacks(const BoardPosBitset &sliders, const BoardPosBitset &passable, Vec2 dir, uint8_t range) {
+		if(!range) {
+			return {};
+		}
+		switch((dir.y + 1) * 3 + dir.x + 1) {
+			case 0:
+				return slideAttacks<-1, -1>(sliders, passable, range);
+			case 1:
+				return slideAttacks<0, -1>(sliders, passable, range);
+			case 2:
+				return slideAttacks<1, -1>(sliders, passable, range);
+			case 3:
+				return slideAttacks<-1, 0>(sliders, passable, range);
+			case 5:
+				return slideAttacks<1, 0>(sliders, passable, range);
+			case 6:
+				return slideAttacks<-1, 1>(sliders, passable, range);
+			case 7:
+				return slideAttacks<0, 1>(sliders, passable, range);
+			case 8:
+				return slideAttacks<1, 1>(sliders, passable, range);
+		}
+		// slide group generation makes sure every direction is one of the 8 above
+		return {};
+	}
+	
+	// The pieces' slides are grouped by their direction on the board and their range, so that each group can be flood filled together.
+	// Range-capturing slides are blocked by different pieces depending on the slider's rank, so they have their own groups for each rank.
+	struct SlideGroup {
+		Vec2 dir;
+		uint8_t range;
+		// 0 for normal slides, otherwise the rank of the range-capturing piece
+		uint8_t rangeCapturingRank;
+	
+		constexpr bool operator==(const SlideGroup&) const = default;
+	};
+	struct SlideGroupTables {
+		std::array<SlideGroup, MAX_SLIDE_GROUPS> groups{};
+		size_t groupCount = 0;
+		// [slide][owner], indexing movementTables.slides. only the species' plain slides have one, not the slides in compound moves.
+		std::array<std::array<uint8_t, 2>, MovementTablesGeneration::SIZES.slides> slideGroups{};
+	};
+	consteval SlideGroupTables generateSlideGroupTables() {
+		SlideGroupTables tables;
+		for(size_t species = 0; species < 302; species++) {
+			bool pieceIsRangeCapturing = movementTables.flags[species] & SPECIES_RANGE_CAPTURING;
+			uint8_t pieceRank = movementTables.flags[species] & SPECIES_RANK_MASK;
+			MovementSpan slideSpan = movementTables.slideSpans[species];
+			for(size_t slideI = slideSpan.offset; slideI < slideSpan.offset + slideSpan.count; slideI++) {
+				const Slide &slide = movementTables.slides[slideI];
+				for(uint8_t owner = 0; owner < 2; owner++) {
+					// the same rule as move generation for which of their slides are range-capturing
+					SlideGroup group = { movementDirToBoardDir(slide.dir, owner), slide.range, static_cast<uint8_t>(pieceIsRangeCapturing && slide.range == 35? pieceRank : 0) };
+					auto it = std::find(tables.groups.begin(), tables.groups.begin() + tables.groupCount, group);
+					if(it == tables.groups.begin() + tables.groupCount) {
+						if(tables.groupCount == MAX_SLIDE_GROUPS) {
+							throw std::runtime_error("Too many slide groups!");
+						}
+						tables.groups[tables.groupCount++] = group;
+					}
+					tables.slideGroups[slideI][owner] = it - tables.groups.begin();
+				}
+			}
+		}
+		return tables;
+	}
+	inline constexpr SlideGroupTables slideGroupTables = generateSlideGroupTables();
+}
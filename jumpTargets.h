@@ -0,0 +1,68 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// Bitsets of the squares a species' jumps land on from each square, so that generating jump moves is a table lookup rather than bounds-checking every jump.
+// A full table per species and owner would be over 100MB, but lots of species share the same jumps (e.g. all the 1-square steppers), so species with the same jumps on the board (after flipping for the owner) share a table. There are 82 of them.
+// Only the species' plain jumps are included, not the jumps in compound moves.
+// This file relies on movementTables, movementDirToBoardDir and BoardPosBitset from tomatene.cpp.
+class JumpTargetTable {
+private:
+	static constexpr uint8_t NO_JUMPS = UINT8_MAX;
+
+	// [pattern * 1296 + square]
+	std::vector<BoardPosBitset> targets;
+	// [species][owner]
+	std::array<std::array<uint8_t, 2>, 302> patternIndices;
+public:
+	JumpTargetTable() {
+		std::vector<std::vector<Vec2>> patterns;
+		for(size_t species = 0; species < 302; species++) {
+			for(uint8_t owner = 0; owner < 2; owner++) {
+				auto jumps = movementTables.getJumps(species);
+				if(jumps.empty()) {
+					patternIndices[species][owner] = NO_JUMPS;
+					continue;
+				}
+				std::vector<Vec2> boardJumps;
+				for(Vec2 jump : jumps) {
+					boardJumps.push_back(movementDirToBoardDir(jump, owner));
+				}
+				std::sort(boardJumps.begin(), boardJumps.end(), [](Vec2 a, Vec2 b) {
+					return a.y == b.y? a.x < b.x : a.y < b.y;
+				});
+				auto it = std::find(patterns.begin(), patterns.end(), boardJumps);
+				patternIndices[species][owner] = it - patterns.begin();
+				if(it == patterns.end()) {
+					patterns.push_back(std::move(boardJumps));
+				}
+			}
+		}
+		if(patterns.size() >= NO_JUMPS) {
+			throw std::runtime_error("Too many jump patterns!");
+		}
+
+		targets.resize(patterns.size() * 1296);
+		for(size_t pattern = 0; pattern < patterns.size(); pattern++) {
+			for(size_t srcI = 0; srcI < 1296; srcI++) {
+				Vec2 src = Vec2::fromIndex(srcI);
+				for(Vec2 jump : patterns[pattern]) {
+					Vec2 target = src + jump;
+					if(isPosWithinBounds(target)) {
+						targets[pattern * 1296 + srcI].insert(target);
+					}
+				}
+			}
+		}
+	}
+
+	// Returns the squares a piece's jumps land on, or nullptr if it doesn't have any jumps
+	inline const BoardPosBitset *get(PieceSpecies::Type species, uint8_t owner, size_t srcI) const {
+		uint8_t pattern = patternIndices[species][owner];
+		return pattern == NO_JUMPS? nullptr : &targets[pattern * 1296 + srcI];
+	}
+};
+
+inline const JumpTargetTable jumpTargetTable;
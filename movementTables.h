@@ -0,0 +1,166 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+// Flat versions of every species' movements from pieces.inc, generated at compile time.
+// Each kind of movement lives in one array shared by all species, and each species has a span (offset and count) into it. Compound moves' steps point into the same slide and jump arrays.
+// This file relies on PieceSpecies, Slide, Movements etc. from tomatene.cpp.
+
+struct MovementSpan {
+	uint16_t offset;
+	uint16_t count;
+};
+struct FlatCompoundMove {
+	MovementSpan firstStepSlides;
+	MovementSpan firstStepJumps;
+	bool canContinueAfterCapture;
+	MovementSpan secondStepSlides;
+	MovementSpan secondStepJumps;
+};
+
+inline constexpr uint8_t SPECIES_RANK_MASK = 0b111;
+inline constexpr uint8_t SPECIES_RANGE_CAPTURING = 1 << 3;
+inline constexpr uint8_t SPECIES_ROYAL = 1 << 4;
+// which lines (through the piece) a range-capturing piece's range-capturing slides go along
+inline constexpr uint8_t SPECIES_RANGE_CAPTURES_ORTHOGONALLY = 1 << 5;
+inline constexpr uint8_t SPECIES_RANGE_CAPTURES_DIAGONALLY = 1 << 6;
+
+namespace MovementTablesGeneration {
+	// Calls f(species, movements) for every species in pieces.inc. The movements are made of vectors, so they can only be used while generating.
+	template <typename F>
+	constexpr void forEachSpeciesMovements(F &&f) {
+		#define Piece(code, promo, move) f(PieceSpecies::code, Movements UNPAREN move);
+			#include "pieces.inc"
+		#undef Piece
+	}
+
+	struct Sizes {
+		size_t slides = 0;
+		size_t jumps = 0;
+		size_t tripleSlashedArrowDirs = 0;
+		size_t compoundMoves = 0;
+	};
+	consteval Sizes countMovements() {
+		Sizes sizes;
+		forEachSpeciesMovements([&](PieceSpecies::Type, const Movements &movements) {
+			sizes.slides += movements.slides.size();
+			sizes.jumps += movements.jumps.size();
+			sizes.tripleSlashedArrowDirs += movements.tripleSlashedArrowDirs.size();
+			sizes.compoundMoves += movements.compoundMoves.size();
+			for(const CompoundMove &compoundMove : movements.compoundMoves) {
+				sizes.slides += compoundMove.firstStep.slides.size() + compoundMove.secondStep.slides.size();
+				sizes.jumps += compoundMove.firstStep.jumps.size() + compoundMove.secondStep.jumps.size();
+			}
+		});
+		return sizes;
+	}
+	inline constexpr Sizes SIZES = countMovements();
+}
+
+struct MovementTables {
+	std::array<Slide, MovementTablesGeneration::SIZES.slides> slides{};
+	std::array<Vec2, MovementTablesGeneration::SIZES.jumps> jumps{};
+	std::array<Vec2, MovementTablesGeneration::SIZES.tripleSlashedArrowDirs> tripleSlashedArrowDirs{};
+	std::array<FlatCompoundMove, MovementTablesGeneration::SIZES.compoundMoves> compoundMoves{};
+
+	std::array<MovementSpan, 302> slideSpans{};
+	std::array<MovementSpan, 302> jumpSpans{};
+	std::array<MovementSpan, 302> tripleSlashedArrowDirSpans{};
+	std::array<MovementSpan, 302> compoundMoveSpans{};
+	// rank in the lowest bits, then the SPECIES_* flags
+	std::array<uint8_t, 302> flags{};
+
+	constexpr std::span<const Slide> getSlides(MovementSpan span) const {
+		return { slides.data() + span.offset, span.count };
+	}
+	constexpr std::span<const Vec2> getJumps(MovementSpan span) const {
+		return { jumps.data() + span.offset, span.count };
+	}
+	constexpr std::span<const Slide> getSlides(uint16_t species) const {
+		return getSlides(slideSpans[species]);
+	}
+	constexpr std::span<const Vec2> getJumps(uint16_t species) const {
+		return getJumps(jumpSpans[species]);
+	}
+	constexpr std::span<const Vec2> getTripleSlashedArrowDirs(uint16_t species) const {
+		MovementSpan span = tripleSlashedArrowDirSpans[species];
+		return { tripleSlashedArrowDirs.data() + span.offset, span.count };
+	}
+	constexpr std::span<const FlatCompoundMove> getCompoundMoves(uint16_t species) const {
+		MovementSpan span = compoundMoveSpans[species];
+		return { compoundMoves.data() + span.offset, span.count };
+	}
+};
+
+namespace MovementTablesGeneration {
+	constexpr uint8_t getLineFlags(Vec2 dir) {
+		return (dir.x == 0 || dir.y == 0? SPECIES_RANGE_CAPTURES_ORTHOGONALLY : 0) | (dir.x == dir.y || dir.x == -dir.y? SPECIES_RANGE_CAPTURES_DIAGONALLY : 0);
+	}
+	// Range-capturing slides' moves get told apart from the piece's other moves by the lines they're along (see GameState::getAllMovesForPlayer), so nothing else the piece does can be along those lines
+	constexpr uint8_t getRangeCapturingLineFlags(const Movements &movements) {
+		uint8_t lineFlags = 0;
+		for(const Slide &slide : movements.slides) {
+			if(slide.range == 35) {
+				if(!getLineFlags(slide.dir)) {
+					throw std::runtime_error("Range-capturing slides have to be orthogonal or diagonal!");
+				}
+				lineFlags |= getLineFlags(slide.dir);
+			}
+		}
+		for(const Slide &slide : movements.slides) {
+			if(slide.range != 35 && getLineFlags(slide.dir) & lineFlags) {
+				throw std::runtime_error("A range-capturing piece has another slide along a range-capturing line!");
+			}
+		}
+		for(const Vec2 &jump : movements.jumps) {
+			if(getLineFlags(jump) & lineFlags) {
+				throw std::runtime_error("A range-capturing piece has a jump along a range-capturing line!");
+			}
+		}
+		if(movements.tripleSlashedArrowDirs.size() || movements.compoundMoves.size()) {
+			throw std::runtime_error("Range-capturing pieces can only have slides and jumps!");
+		}
+		return lineFlags;
+	}
+	consteval MovementTables generate() {
+		MovementTables tables;
+		Sizes sizes;
+		auto addSlides = [&](const std::vector<Slide> &slides) {
+			MovementSpan span = { static_cast<uint16_t>(sizes.slides), static_cast<uint16_t>(slides.size()) };
+			for(const Slide &slide : slides) {
+				tables.slides[sizes.slides++] = slide;
+			}
+			return span;
+		};
+		auto addJumps = [&](const std::vector<Vec2> &jumps) {
+			MovementSpan span = { static_cast<uint16_t>(sizes.jumps), static_cast<uint16_t>(jumps.size()) };
+			for(const Vec2 &jump : jumps) {
+				tables.jumps[sizes.jumps++] = jump;
+			}
+			return span;
+		};
+		forEachSpeciesMovements([&](PieceSpecies::Type species, const Movements &movements) {
+			tables.slideSpans[species] = addSlides(movements.slides);
+			tables.jumpSpans[species] = addJumps(movements.jumps);
+			tables.tripleSlashedArrowDirSpans[species] = { static_cast<uint16_t>(sizes.tripleSlashedArrowDirs), static_cast<uint16_t>(movements.tripleSlashedArrowDirs.size()) };
+			for(const Vec2 &dir : movements.tripleSlashedArrowDirs) {
+				tables.tripleSlashedArrowDirs[sizes.tripleSlashedArrowDirs++] = dir;
+			}
+			tables.compoundMoveSpans[species] = { static_cast<uint16_t>(sizes.compoundMoves), static_cast<uint16_t>(movements.compoundMoves.size()) };
+			for(const CompoundMove &compoundMove : movements.compoundMoves) {
+				FlatCompoundMove &flatCompoundMove = tables.compoundMoves[sizes.compoundMoves++];
+				flatCompoundMove.firstStepSlides = addSlides(compoundMove.firstStep.slides);
+				flatCompoundMove.firstStepJumps = addJumps(compoundMove.firstStep.jumps);
+				flatCompoundMove.canContinueAfterCapture = compoundMove.firstStep.canContinueAfterCapture;
+				flatCompoundMove.secondStepSlides = addSlides(compoundMove.secondStep.slides);
+				flatCompoundMove.secondStepJumps = addJumps(compoundMove.secondStep.jumps);
+			}
+			tables.flags[species] = getSpeciesRank(species) | (isRangeCapturingPiece(species)? SPECIES_RANGE_CAPTURING | getRangeCapturingLineFlags(movements) : 0) | (isRoyalPiece(species)? SPECIES_ROYAL : 0);
+		});
+		return tables;
+	}
+}
+
+inline constexpr MovementTables movementTables = MovementTablesGeneration::generate();
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// How many bits the perft table keys should be.
+constexpr inline uint32_t PERFT_TABLE_BITS = 20;
+constexpr inline uint32_t PERFT_TABLE_SIZE = 1u << PERFT_TABLE_BITS;
+constexpr inline hash_t PERFT_HASH_MASK = PERFT_TABLE_SIZE - 1;
+
+struct PerftTableEntry {
+	hash_t hash = 0;
+	uint64_t nodes = 0;
+	// 0 marks an empty entry, since depth 0 is never stored (it's always 1 node)
+	depth_t depth = 0;
+};
+
+// A cache of perft node counts, kept apart from the transposition table so perft doesn't corrupt it. The same position can be reached at different depths, so entries are keyed by both the hash and the depth.
+class PerftTable {
+private:
+	// allocated by the first put (or clear) so the engine doesn't pay for it when perft is never run
+	std::vector<PerftTableEntry> table;
+	static constexpr inline hash_t getIndex(hash_t hash, depth_t depth) {
+		return (hash ^ depth * 0x9E3779B97F4A7C15ULL) & PERFT_HASH_MASK;
+	}
+public:
+	const PerftTableEntry* get(hash_t hash, depth_t depth) const {
+		if(table.empty()) {
+			return nullptr;
+		}
+		const PerftTableEntry &entry = table[getIndex(hash, depth)];
+		if(entry.hash == hash && entry.depth == depth) {
+			return &entry;
+		}
+		return nullptr;
+	}
+	void put(hash_t hash, depth_t depth, uint64_t nodes) {
+		if(table.empty()) {
+			clear();
+		}
+		table[getIndex(hash, depth)] = { hash, nodes, depth };
+	}
+	void clear() {
+		table.assign(PERFT_TABLE_SIZE, PerftTableEntry{});
+	}
+};
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <string>
 #include <vector>
 
 // xoroshiro128+ PRNG
@@ -28,7 +29,42 @@ struct xoroshiro128plus {
     }
 };
 
-int main() {
+// Writes the full [species][owner][square] table of independent keys used by zobristHashes.h. The Makefile runs this to generate zobristFullTable.inc.
+// There are far too many keys to search for a set with a good minimum Hamming distance like below, so these are just the raw PRNG output.
+int write_full_table() {
+    constexpr int num_species = 302; // including the empty species 0
+    constexpr int num_owners  = 2;
+    constexpr int num_squares = 36 * 36;
+
+    xoroshiro128plus rng{{0x2F1B3C4D5E6F7081ULL, 0x1827364554637281ULL}};
+
+    std::ofstream out("zobristFullTable.inc");
+    out << "// Generated by scripts/generate64BitZobristKeys.cpp full\n";
+    out << "// [species][owner][square] -> key; species 0 (no piece) is all zeros\n";
+    for (int species = 0; species < num_species; ++species) {
+        out << "{{\n";
+        for (int owner = 0; owner < num_owners; ++owner) {
+            out << "{{";
+            for (int square = 0; square < num_squares; ++square) {
+                uint64_t key = species? rng.next64() : 0;
+                out << key << "ULL" << (square < num_squares - 1 ? "," : "");
+            }
+            out << "}}" << (owner < num_owners - 1 ? "," : "") << "\n";
+        }
+        out << "}}" << (species < num_species - 1 ? "," : "") << "\n";
+    }
+    out.close();
+
+    std::cout << "Wrote " << num_species * num_owners * num_squares
+              << " keys to zobristFullTable.inc\n";
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::string(argv[1]) == "full") {
+        return write_full_table();
+    }
+
     constexpr int num_pieces = 301;
     constexpr int num_ranks  = 36;
     constexpr int num_files  = 36;
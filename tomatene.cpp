@@ -1,7 +1,11 @@
 #include <iostream>
 #include <sstream>
 #include <chrono>
+#include <cstring>
 #include <cmath>
+#include <random>
+#include <unordered_map>
+#include <memory>
 
 #include <frozen/unordered_map.h>
 #include <frozen/string.h>
@@ -11,17 +15,73 @@
 #define ENGINE_AUTHOR "s1050613"
 #define ENGINE_VERSION std::format("v1 {} {}", __DATE__, __TIME__)
 
+#if defined(RUNTIME_DISPATCH) && defined(__ELF__)
+	// The portable build is compiled for any x86-64 CPU, but the hot functions are also compiled for x86-64-v3 (AVX2) and x86-64-v4 (AVX-512) CPUs, and the best version gets picked when the program starts.
+	// Lambdas and other functions they call only get compiled for the baseline CPU unless they're inlined, so they're flattened to inline everything (the bitset operations especially).
+	// This needs ifuncs, so other targets (e.g. Windows) just get the baseline version.
+	#define MULTIVERSIONED [[gnu::target_clones("arch=x86-64-v4", "arch=x86-64-v3", "default"), gnu::flatten]]
+#else
+	#define MULTIVERSIONED
+#endif
+
 // Centipawns
 typedef int32_t eval_t;
 typedef uint8_t depth_t;
 typedef uint64_t hash_t;
 
 #include "transpositionTable.h"
+#include "perftTable.h"
 
 inline constexpr eval_t MAX_EVAL = 100000000;
 inline constexpr depth_t MAX_DEPTH = 3;
 inline constexpr float ESTIMATED_GAME_LENGTH = 900;
 
+#ifdef COUNT_ALLOCATIONS
+	// counts every heap allocation, so timed commands can report how many happen per node
+	size_t allocationCount = 0;
+	void *operator new(size_t size) {
+		allocationCount++;
+		if(void *ptr = std::malloc(size)) {
+			return ptr;
+		}
+		throw std::bad_alloc();
+	}
+	void operator delete(void *ptr) noexcept {
+		std::free(ptr);
+	}
+	void operator delete(void *ptr, size_t) noexcept {
+		std::free(ptr);
+	}
+	// over-aligned types (BoardPosBitset and everything holding one) go through these instead
+	void *operator new(size_t size, std::align_val_t alignment) {
+		allocationCount++;
+		size_t align = static_cast<size_t>(alignment);
+		#ifdef _WIN32
+			void *ptr = _aligned_malloc(size, align);
+		#else
+			void *ptr = std::aligned_alloc(align, (size + align - 1) / align * align); // aligned_alloc needs the size to be a multiple of the alignment
+		#endif
+		if(ptr) {
+			return ptr;
+		}
+		throw std::bad_alloc();
+	}
+	void operator delete(void *ptr, std::align_val_t) noexcept {
+		#ifdef _WIN32
+			_aligned_free(ptr);
+		#else
+			std::free(ptr);
+		#endif
+	}
+	void operator delete(void *ptr, size_t, std::align_val_t) noexcept {
+		#ifdef _WIN32
+			_aligned_free(ptr);
+		#else
+			std::free(ptr);
+		#endif
+	}
+#endif
+
 constexpr std::vector<std::string> splitString(std::string str, char delimiter) {
 	std::vector<std::string> res;
 	std::stringstream ss(str);
@@ -129,6 +189,20 @@ inline constexpr bool isLionLikePiece(PieceSpecies::Type pieceSpecies) {
 inline constexpr bool isRangeCapturingPiece(PieceSpecies::Type pieceSpecies) {
 	return pieceSpecies == PieceSpecies::GG || pieceSpecies == PieceSpecies::VG || pieceSpecies == PieceSpecies::FLG || pieceSpecies == PieceSpecies::AG || pieceSpecies == PieceSpecies::FID || pieceSpecies == PieceSpecies::FCR;
 }
+inline constexpr bool isRoyalPiece(PieceSpecies::Type pieceSpecies) {
+	return pieceSpecies == PieceSpecies::K || pieceSpecies == PieceSpecies::CP;
+}
+// Range-capturing pieces can only jump over pieces of a lower rank
+inline constexpr uint8_t getSpeciesRank(PieceSpecies::Type pieceSpecies) {
+	if(isRoyalPiece(pieceSpecies)) return 4;
+	if(pieceSpecies == PieceSpecies::GG) return 3;
+	if(pieceSpecies == PieceSpecies::VG) return 2;
+	if(pieceSpecies == PieceSpecies::FLG) return 1;
+	if(pieceSpecies == PieceSpecies::AG) return 1;
+	if(pieceSpecies == PieceSpecies::FID) return 1;
+	if(pieceSpecies == PieceSpecies::FCR) return 1;
+	return 0;
+}
 
 struct Vec2 {
 	int8_t x;
@@ -187,19 +261,20 @@ struct Movements {
 };
 
 struct PieceInfo {
-	std::string name;
+	std::string_view name;
 	PieceSpecies::Type promotion;
-	Movements movements;
 };
-#define UNPAREN(...) __VA_ARGS__
-const std::array<PieceInfo, 302> PieceTable = { {
-	{ "[None]", PieceSpecies::None, {} },
-	#define Piece(code, promo, move) { #code, PieceSpecies::promo, UNPAREN move },
+inline constexpr std::array<PieceInfo, 302> PieceTable = { {
+	{ "[None]", PieceSpecies::None },
+	#define Piece(code, promo, move) { #code, PieceSpecies::promo },
 		#include "pieces.inc"
 	#undef Piece
 } };
 
-float getDirectionValue(Vec2 dir) {
+#define UNPAREN(...) __VA_ARGS__
+#include "movementTables.h"
+
+constexpr float getDirectionValue(Vec2 dir) {
 	if(!dir.x && dir.y > 0) {
 		// straight forward
 		return 1;
@@ -219,7 +294,7 @@ float getDirectionValue(Vec2 dir) {
 	// straight backwards
 	return 0.6;
 }
-inline std::array<eval_t, 302> calculateBasePieceValues() {
+constexpr std::array<eval_t, 302> calculateBasePieceValues() {
 	const float basePieceValue = 100;
 	const float movementFactor = 5;
 	const float rangeCapturingFactor = 15;
@@ -229,34 +304,33 @@ inline std::array<eval_t, 302> calculateBasePieceValues() {
 	const float unableToReachOtherColouredSquaresFactor = 0.6;
 	const float royalBonus = 100000;
 	
-	std::array<eval_t, 302> values;
+	std::array<eval_t, 302> values{};
 	values[0] = 0;
 	for(int pieceSpecies = 1; pieceSpecies < 302; pieceSpecies++) {
-		const Movements &movements = PieceTable[pieceSpecies].movements;
 		bool canReachOtherColouredSquares = false;
 		float movementValue = 0;
-		for(const auto &slide : movements.slides) {
-			bool isRangeCapturingSlide = isRangeCapturingPiece(static_cast<PieceSpecies::Type>(pieceSpecies)) && slide.range == 35;
+		for(const auto &slide : movementTables.getSlides(pieceSpecies)) {
+			bool isRangeCapturingSlide = movementTables.flags[pieceSpecies] & SPECIES_RANGE_CAPTURING && slide.range == 35;
 			movementValue += slide.range * (isRangeCapturingSlide? rangeCapturingFactor : 1) * getDirectionValue(slide.dir);
 			if(slide.dir.x % 2 || slide.dir.y % 2) {
 				canReachOtherColouredSquares = true;
 			}
 		}
-		for(const auto &jump : movements.jumps) {
+		for(const auto &jump : movementTables.getJumps(pieceSpecies)) {
 			movementValue += jump.magnitude() * getDirectionValue(jump) * (std::abs(jump.x) > 1 || std::abs(jump.y) > 1? jumpFactor : 1);
 			if(jump.x % 2 || jump.y % 2) {
 				canReachOtherColouredSquares = true;
 			}
 		}
-		for(Vec2 tripleSlashedArrowDir : movements.tripleSlashedArrowDirs) {
+		for(Vec2 tripleSlashedArrowDir : movementTables.getTripleSlashedArrowDirs(pieceSpecies)) {
 			movementValue += 35 * tripleSlashedArrowFactor * getDirectionValue(tripleSlashedArrowDir);
 			if(tripleSlashedArrowDir.x % 2 || tripleSlashedArrowDir.y % 2) {
 				canReachOtherColouredSquares = true;
 			}
 		}
-		for(CompoundMove compoundMove : movements.compoundMoves) {
+		for(const FlatCompoundMove &compoundMove : movementTables.getCompoundMoves(pieceSpecies)) {
 			float firstStepValue = 0;
-			for(const auto &slide : compoundMove.firstStep.slides) {
+			for(const auto &slide : movementTables.getSlides(compoundMove.firstStepSlides)) {
 				float slideValue = slide.range * getDirectionValue(slide.dir);
 				movementValue += slideValue;
 				firstStepValue += slideValue;
@@ -264,7 +338,7 @@ inline std::array<eval_t, 302> calculateBasePieceValues() {
 					canReachOtherColouredSquares = true;
 				}
 			}
-			for(const auto &jump : compoundMove.firstStep.jumps) {
+			for(const auto &jump : movementTables.getJumps(compoundMove.firstStepJumps)) {
 				float jumpValue = jump.magnitude() * getDirectionValue(jump);
 				movementValue += jumpValue * (std::abs(jump.x) > 1 || std::abs(jump.y) > 1? jumpFactor : 1);
 				firstStepValue += jumpValue;
@@ -272,20 +346,20 @@ inline std::array<eval_t, 302> calculateBasePieceValues() {
 					canReachOtherColouredSquares = true;
 				}
 			}
-			if(compoundMove.firstStep.canContinueAfterCapture) {
+			if(compoundMove.canContinueAfterCapture) {
 				firstStepValue *= doubleCaptureFactor;
 			}
 			
 			firstStepValue = std::pow(firstStepValue, 0.7);
 			
-			for(const auto &slide : compoundMove.secondStep.slides) {
+			for(const auto &slide : movementTables.getSlides(compoundMove.secondStepSlides)) {
 				float slideValue = slide.range * getDirectionValue(slide.dir);
 				movementValue += slideValue * firstStepValue;
 				if(slide.dir.x % 2 || slide.dir.y % 2) {
 					canReachOtherColouredSquares = true;
 				}
 			}
-			for(const auto &jump : compoundMove.secondStep.jumps) {
+			for(const auto &jump : movementTables.getJumps(compoundMove.secondStepJumps)) {
 				float jumpValue = jump.magnitude() * getDirectionValue(jump) * (std::abs(jump.x) > 1 || std::abs(jump.y) > 1? jumpFactor : 1);
 				movementValue += jumpValue * firstStepValue;
 				if(jump.x % 2 || jump.y % 2) {
@@ -304,13 +378,13 @@ inline std::array<eval_t, 302> calculateBasePieceValues() {
 	for(int pieceSpecies = 1; pieceSpecies < 302; pieceSpecies++) {
 		values[pieceSpecies] *= 100;
 		values[pieceSpecies] /= pawnValue;
-		if(pieceSpecies == PieceSpecies::K || pieceSpecies == PieceSpecies::CP) {
+		if(movementTables.flags[pieceSpecies] & SPECIES_ROYAL) {
 			values[pieceSpecies] += royalBonus;
 		}
 	}
 	return values;
 }
-const std::array<eval_t, 302> basePieceValues = calculateBasePieceValues();
+inline constexpr std::array<eval_t, 302> basePieceValues = calculateBasePieceValues();
 
 inline constexpr frozen::unordered_map<frozen::string, uint16_t, PieceSpecies::TotalCount - 1> PieceSpeciesToId = {
 	#define Piece(code, promo, move) { #code, PieceSpecies::code },
@@ -325,8 +399,13 @@ struct PieceIdsWrapper {
 inline constexpr PieceIdsWrapper pieceIds;
 
 TranspositionTable transpositionTable;
+PerftTable perftTable;
 
 std::array<std::array<uint32_t, MAX_DEPTH + 1>, 2> killerMoves{};
+#ifdef SPECIES_MOVE_GENERATORS
+	// whether to use the move generators compiled for each species, rather than interpreting the movement tables at runtime. can be switched with the `movegen` command to compare them.
+	bool useSpeciesMoveGenerators = true;
+#endif
 
 bool atsiInitialised = false;
 uint8_t player = 0;
@@ -395,26 +474,20 @@ struct Piece {
 	constexpr inline uint8_t getOwner() const {
 		return value >> 10;
 	}
-	inline uint16_t canPromote() const {
+	constexpr inline uint16_t canPromote() const {
 		return ((value >> 9) & 1) && PieceTable[getSpecies()].promotion != 0;
 	}
 	constexpr inline PieceSpecies::Type getSpecies() const {
 		return static_cast<PieceSpecies::Type>(value & 0b111111111);
 	}
 	constexpr inline bool isRoyal() const {
-		uint16_t pieceSpecies = getSpecies();
-		return pieceSpecies == PieceSpecies::K || pieceSpecies == PieceSpecies::CP;
+		return movementTables.flags[getSpecies()] & SPECIES_ROYAL;
+	}
+	constexpr inline bool isRangeCapturing() const {
+		return movementTables.flags[getSpecies()] & SPECIES_RANGE_CAPTURING;
 	}
 	constexpr inline uint8_t getRank() const {
-		if(isRoyal()) return 4;
-		uint16_t pieceSpecies = getSpecies();
-		if(pieceSpecies == PieceSpecies::GG) return 3;
-		if(pieceSpecies == PieceSpecies::VG) return 2;
-		if(pieceSpecies == PieceSpecies::FLG) return 1;
-		if(pieceSpecies == PieceSpecies::AG) return 1;
-		if(pieceSpecies == PieceSpecies::FID) return 1;
-		if(pieceSpecies == PieceSpecies::FCR) return 1;
-		return 0;
+		return movementTables.flags[getSpecies()] & SPECIES_RANK_MASK;
 	}
 	constexpr inline bool isInPromotionZone(int8_t y) const {
 		return getOwner()? y > 24 : y < 11;
@@ -462,7 +535,43 @@ inline constexpr Vec2 movementDirToBoardDir(Vec2 movementDir, uint8_t pieceOwner
 // this file relies on Piece. I'm too lazy to add proper header files.
 #include "zobristHashes.h"
 #include "boardPosBitset.h"
+#include "jumpTargets.h"
+#include "areaMoves.h"
+#include "floodFill.h"
 
+// [dest index]: the destination's bits of a move, so that createMove(src, dest) == createMove(src, { 0, 0 }) | MOVE_DESTINATIONS[dest index], for expanding destination bitsets into moves all at once
+inline constexpr BoardPosBitset::ExpansionValues MOVE_DESTINATIONS = [] {
+	BoardPosBitset::ExpansionValues destinations{};
+	for(size_t i = 0; i < 1296; i++) {
+		destinations[i] = createMove({ 0, 0 }, Vec2::fromIndex(i));
+	}
+	return destinations;
+}();
+// Every square in each line across the board, for picking out range-capturing slides' destinations
+struct BoardLines {
+	// [y]
+	std::array<BoardPosBitset, 36> rows;
+	// [x]
+	std::array<BoardPosBitset, 36> columns;
+	// [x - y + 35]
+	std::array<BoardPosBitset, 71> diagonals;
+	// [x + y]
+	std::array<BoardPosBitset, 71> antidiagonals;
+};
+inline constexpr BoardLines BOARD_LINES = [] {
+	BoardLines lines;
+	for(size_t i = 0; i < 1296; i++) {
+		Vec2 pos = Vec2::fromIndex(i);
+		lines.rows[pos.y].insert(i);
+		lines.columns[pos.x].insert(i);
+		lines.diagonals[pos.x - pos.y + 35].insert(i);
+		lines.antidiagonals[pos.x + pos.y].insert(i);
+	}
+	return lines;
+}();
+
+// Which squares each piece attacks, and which pieces attack each square, both as full bitsets (about 250KB each).
+// Storing them compactly so they'd fit in L2 was tried and dropped. Packing just each piece's attacks (only their non-empty words, in a shared pool) made perft 5-20% slower, and packing the reverse attacks as well, which get a bit inserted or erased for every attack that changes, made it 25-40% slower.
 class BidirectionalAttackMap {
 private:
 	std::array<BoardPosBitset, 1296> attackMap{};
@@ -477,14 +586,18 @@ public:
 	inline constexpr const BoardPosBitset &getReverseAttacks(const Vec2 src) const {
 		return reverseAttackMap[src.toIndex()];
 	}
+	inline constexpr const BoardPosBitset &getAttacks(size_t srcI) const {
+		return attackMap[srcI];
+	}
 	inline constexpr void setAttacks(size_t srcI, const BoardPosBitset &attacks) {
 		BoardPosBitset &currentAttacks = attackMap[srcI];
 		
-		// find the changed attacks and update them accordingly
-		currentAttacks.bitTransformForEach(attacks, [](uint64_t oldW, uint64_t newW) {
-			// doing a single xor operation rather than two & ~ operations is a bit faster
-			return oldW ^ newW;
-		}, [this, srcI, &attacks](size_t targetI) {
+		// find the changed attacks and update them accordingly. most of the time a piece's attacks haven't changed at all, which the vectorised xor finds out straight away
+		BoardPosBitset changedAttacks = currentAttacks ^ attacks;
+		if(changedAttacks.isEmpty()) {
+			return;
+		}
+		changedAttacks.forEach([this, srcI, &attacks](size_t targetI) {
 			if(attacks.contains(targetI)) {
 				insertReverse(srcI, targetI);
 			} else {
@@ -525,6 +638,9 @@ public:
 	inline constexpr size_t size() {
 		return currentSize;
 	}
+	inline constexpr void clear() {
+		currentSize = 0;
+	}
 	inline constexpr T& back() {
 		if(!currentSize) {
 			throw std::runtime_error("StaticVector error: Cannot call back(), empty!");
@@ -544,26 +660,132 @@ public:
 		return data.data() + currentSize;
 	}
 };
+// A list of moves that getAllMovesForPlayer writes straight into. Unlike std::vector, making room for more doesn't initialise the new space, so moves can be written past the end and then taken in with setEnd.
+// It keeps its memory when it's refilled, so one kept between calls stops allocating once it's big enough.
+class MoveList {
+private:
+	std::unique_ptr<uint32_t[]> moves;
+	size_t capacity = 0;
+	size_t currentSize = 0;
+public:
+	// Makes sure count moves can be written after the end, and returns where they go
+	inline uint32_t* makeRoomFor(size_t count) {
+		if(currentSize + count > capacity) {
+			size_t newCapacity = std::max(currentSize + count, capacity * 2);
+			std::unique_ptr<uint32_t[]> newMoves = std::make_unique_for_overwrite<uint32_t[]>(newCapacity);
+			std::copy(begin(), end(), newMoves.get());
+			moves = std::move(newMoves);
+			capacity = newCapacity;
+		}
+		return end();
+	}
+	// Takes in the moves written after the end, up to newEnd
+	inline void setEnd(uint32_t *newEnd) {
+		currentSize = newEnd - moves.get();
+	}
+	inline void truncate(size_t maxSize) {
+		currentSize = std::min(currentSize, maxSize);
+	}
+	inline size_t size() const {
+		return currentSize;
+	}
+	inline bool empty() const {
+		return !currentSize;
+	}
+	inline void clear() {
+		currentSize = 0;
+	}
+	inline uint32_t& operator[](size_t i) {
+		return moves[i];
+	}
+	inline uint32_t operator[](size_t i) const {
+		return moves[i];
+	}
+	inline uint32_t* begin() {
+		return moves.get();
+	}
+	inline uint32_t* end() {
+		return moves.get() + currentSize;
+	}
+	inline const uint32_t* begin() const {
+		return moves.get();
+	}
+	inline const uint32_t* end() const {
+		return moves.get() + currentSize;
+	}
+};
 struct UndoSquare {
 	Vec2 pos;
 	Piece oldPiece;
 };
+// A move that setSquare added to or removed from a piece's moves directly, rather than by regenerating them
+struct MoveDestinationChange {
+	uint16_t srcI;
+	uint16_t destI;
+	bool wasAdded;
+	// from before, since adding a move changes them
+	bool hadMoves;
+	uint32_t moveDestinationWords;
+};
+// A square's moves and attacks from before generateMoves regenerated them
+struct SavedSquareMoves {
+	uint16_t srcI;
+	bool hadMoves;
+	uint32_t moveDestinationWords;
+	AreaMoveDestinations areaMoveDestinations;
+	BoardPosBitset attacks;
+	BoardPosBitset moveDestinations;
+};
+// Everything a move changed about the pieces' moves and attacks, so that unmaking it can put them back rather than regenerating them all again.
+// The changes from setSquare always happen before generateMoves, so unmaking puts back the saved squares first, then undoes the changes, both in reverse order.
+struct MoveDeltas {
+	std::vector<MoveDestinationChange> destinationChanges;
+	std::vector<SavedSquareMoves> savedSquares;
+};
 
 class GameState {
 private:
 	std::array<Piece, 1296> board{};
 	BoardPosBitset occupancyBitset{};
 	std::array<BoardPosBitset, 2> playerOccupancyBitsets{};
+	// [rank - 1] has every piece with at least that rank, i.e. everything that blocks a range-capturing piece of that rank.
+	// Only move generation uses them, so like the attack map they're only kept up to date when moves are being regenerated.
+	std::array<BoardPosBitset, 4> rankOccupancyBitsets{};
 	BidirectionalAttackMap bidirectionalAttackMap;
 	// Squares that need to recalculate their attack map and their moves
 	BoardPosBitset squaresNeedingMoveRecalculation;
-	std::array<std::array<std::vector<uint32_t>, 1296>, 2> movesPerSquarePerPlayer;
+	// Each square's moves, stored as the squares its piece can move to. They only get turned into moves by getAllMovesForPlayer.
+	// Range-capturing slides go in here too. None of those pieces have other moves along the same lines as their range-capturing slides (see MovementTablesGeneration::getRangeCapturingLineFlags), so getAllMovesForPlayer can tell them apart.
+	std::array<BoardPosBitset, 1296> moveDestinations;
+	// which words of moveDestinations have anything in them, so that listing moves can skip the rest. erasing a move doesn't update it, so it can also have some empty words.
+	std::array<uint32_t, 1296> moveDestinationWords{};
+	// squares whose piece has any moves at all. like moveDestinationWords, it can have a few squares which don't anymore.
+	BoardPosBitset squaresWithMoves;
+	// only for pieces with area moves
+	std::array<AreaMoveDestinations, 1296> areaMoveDestinations;
 	// Keeps track of all the squares changed during a move, so that it can quickly unmake the move.
 	StaticVector<StaticVector<UndoSquare, 36>, MAX_DEPTH> undoStack;
+	// [undo stack depth]: the deltas for the moves on the undo stack that regenerated moves. the vectors are kept between moves so they stop allocating once they're big enough.
+	std::array<MoveDeltas, MAX_DEPTH> moveDeltaStack;
 	std::vector<hash_t> positionHashHistory;
 	int positionHashHistorySize = 0;
+	#ifdef ZOBRIST_VERIFICATION
+		// A second, independent hash of the position, used to detect when `hash` collides
+		hash_t verificationHash = 0;
+		std::vector<hash_t> verificationHashHistory;
+	#endif
 	
-	void setSquare(Vec2 pos, Piece piece, bool regenerateMoves = true, bool saveToUndoStack = false) {
+	inline void insertIntoRankOccupancy(Vec2 pos, uint8_t rank) {
+		for(uint8_t i = 0; i < rank; i++) {
+			rankOccupancyBitsets[i].insert(pos);
+		}
+	}
+	inline void eraseFromRankOccupancy(Vec2 pos, uint8_t rank) {
+		for(uint8_t i = 0; i < rank; i++) {
+			rankOccupancyBitsets[i].erase(pos);
+		}
+	}
+	MULTIVERSIONED void setSquare(Vec2 pos, Piece piece, bool regenerateMoves = true, bool saveToUndoStack = false) {
 		uint8_t pieceOwner = piece.getOwner();
 		Piece oldPiece = getSquare(pos);
 		if(piece == oldPiece) return; // idk why
@@ -579,8 +801,14 @@ private:
 			}
 			playerOccupancyBitsets[oldPieceOwner].erase(pos);
 			hash ^= ZobristHashes::getHash(oldPiece, pos);
+			#ifdef ZOBRIST_VERIFICATION
+				verificationHash ^= ZobristHashes::getVerificationHash(oldPiece, pos);
+			#endif
 			if(regenerateMoves) {
 				squaresNeedingMoveRecalculation.insert(pos);
+				uint8_t oldPieceRank = oldPiece.getRank();
+				uint8_t newPieceRank = piece.getRank();
+				eraseFromRankOccupancy(pos, oldPieceRank);
 				bidirectionalAttackMap.getReverseAttacks(pos).forEach([&](size_t i) {
 					Vec2 attackingPos = Vec2::fromIndex(i);
 					Piece attackingPiece = getSquare(attackingPos);
@@ -588,43 +816,50 @@ private:
 						// IDK why this happens sometimes
 						return;
 					}
-					if(isRangeCapturingPiece(attackingPiece.getSpecies())) {
-						uint8_t oldPieceRank = oldPiece.getRank();
-						uint8_t newPieceRank = piece.getRank();
+					if(attackingPiece.isRangeCapturing()) {
 						uint8_t attackingPieceRank = attackingPiece.getRank();
-						// if the rank makes a difference to the range capturing piece which is attacking this square, it needs to recalculate the attack map - it will be attacking more/less squares. if the relative rank doesn't change however, it doesn't need to do anything :)
-						if((oldPieceRank >= attackingPieceRank) != (newPieceRank >= attackingPieceRank)) {
+						// if the rank makes a difference to the range capturing piece which is attacking this square, it needs to recalculate the attack map - it will be attacking more/less squares. if the relative rank doesn't change however, it only needs recalculating if the square's changed owner, since its other moves can capture there now (or can't any more)
+						if((oldPieceRank >= attackingPieceRank) != (newPieceRank >= attackingPieceRank) || oldPieceOwner != pieceOwner) {
 							squaresNeedingMoveRecalculation.insert(i);
 						}
 						return;
 					}
-					// NOTE: Everything above this line is correct. If I insert this squre into `squaresNeedingMoveRecalculation`, it will function exactly as without this optimization. Therefore all issues must be below this line but still inside this function.
 					
 					if(oldPieceOwner == pieceOwner) {
 						// If a range-capturing piece lands on a piece from the same team, moves for regular pieces (i.e. pieces which don't range-capture and hence don't consider rank) don't change at all.
 						// std::cout << std::format("At ({}, {}), {} was replaced by {}, both owned by player {}. Technically: {}, {}", x, y, PieceTable[oldPiece.getSpecies()].name, PieceTable[piece.getSpecies()].name, oldPieceOwner + 1, std::to_string(oldPiece), std::to_string(piece)) << std::endl;
 						return;
 					}
+					// pieces with compound moves (e.g. lions) can carry on past an enemy piece they capture but not past their own, so more than just this square changes for them
+					if(movementTables.compoundMoveSpans[attackingPiece.getSpecies()].count) {
+						squaresNeedingMoveRecalculation.insert(i);
+						return;
+					}
 					
 					uint8_t attackingPieceOwner = attackingPiece.getOwner();
-					uint32_t move = createMove(attackingPos, pos);
-					auto &moves = movesPerSquarePerPlayer[attackingPieceOwner][i];
 					if(attackingPieceOwner == pieceOwner) {
 						// This implies attackingPieceOwner != oldPieceOwner, and hence there previously existed a valid move to this location. However since it is being replaced by a piece from the same team, it is no longer a valid move location and the move has to be removed.
-						auto it = std::find(moves.begin(), moves.end(), move);
-						// if(it == moves.end()) {
+						// if(!moveDestinations[i].contains(pos)) {
 						// 	// should NEVER happen
 						// 	std::cout << std::format("Piece {} at ({}, {}) doesn't have move to remove, to ({}, {}). Previously was player {}'s {}, now is player {}'s {}", PieceTable[attackingPiece.getSpecies()].name, attackingPos.x, attackingPos.y, pos.x, pos.y, oldPiece.getOwner() + 1, PieceTable[oldPiece.getSpecies()].name, piece.getOwner() + 1, PieceTable[piece.getSpecies()].name) << std::endl;
 						// 	return;
 						// }
-						moves.erase(it);
+						if(saveToUndoStack) {
+							moveDeltaStack[undoStack.size() - 1].destinationChanges.push_back({ static_cast<uint16_t>(i), static_cast<uint16_t>(pos.toIndex()), false, squaresWithMoves.contains(i), moveDestinationWords[i] });
+						}
+						moveDestinations[i].erase(pos);
 					} else {
 						// Here it means that there wasn't a valid move to this location, but now that an enemy piece is here, it can now move to this location. Hence a move must be added.
-						// if(std::find(moves.begin(), moves.end(), move) != moves.end()) {
+						// if(moveDestinations[i].contains(pos)) {
 						// 	std::cout << "Already has move" << std::endl;
 						// 	return;
 						// }
-						moves.push_back(move);
+						if(saveToUndoStack) {
+							moveDeltaStack[undoStack.size() - 1].destinationChanges.push_back({ static_cast<uint16_t>(i), static_cast<uint16_t>(pos.toIndex()), true, squaresWithMoves.contains(i), moveDestinationWords[i] });
+						}
+						moveDestinations[i].insert(pos);
+						moveDestinationWords[i] |= BoardPosBitset::getWordMask(pos.toIndex());
+						squaresWithMoves.insert(i);
 					}
 				});
 			}
@@ -645,10 +880,16 @@ private:
 			royalsLeft[pieceOwner]++;
 		}
 		hash ^= ZobristHashes::getHash(piece, pos);
+		#ifdef ZOBRIST_VERIFICATION
+			verificationHash ^= ZobristHashes::getVerificationHash(piece, pos);
+		#endif
 		occupancyBitset.insert(pos);
 		playerOccupancyBitsets[pieceOwner].insert(pos);
+		if(regenerateMoves) {
+			insertIntoRankOccupancy(pos, piece.getRank());
+		}
 	}
-	void clearSquare(Vec2 pos, bool regenerateMoves = true, bool saveToUndoStack = false) {
+	MULTIVERSIONED void clearSquare(Vec2 pos, bool regenerateMoves = true, bool saveToUndoStack = false) {
 		Piece oldPiece = getSquare(pos);
 		if(oldPiece) {
 			if(saveToUndoStack) {
@@ -664,10 +905,14 @@ private:
 			occupancyBitset.erase(pos);
 			playerOccupancyBitsets[oldPieceOwner].erase(pos);
 			if(regenerateMoves) {
+				eraseFromRankOccupancy(pos, oldPiece.getRank());
 				squaresNeedingMoveRecalculation.insert(pos);
 				squaresNeedingMoveRecalculation |= bidirectionalAttackMap.getReverseAttacks(pos);
 			}
 			hash ^= ZobristHashes::getHash(oldPiece, pos);
+			#ifdef ZOBRIST_VERIFICATION
+				verificationHash ^= ZobristHashes::getVerificationHash(oldPiece, pos);
+			#endif
 		}
 	}
 public:
@@ -678,10 +923,17 @@ public:
 	eval_t absEval = 0;
 	hash_t hash = 0;
 	uint16_t age = 0;
+	#ifdef ZOBRIST_VERIFICATION
+		// Number of times a position in the repetition history had the same hash but wasn't actually the same position
+		static inline uint64_t repetitionHashCollisions = 0;
+	#endif
 	
 	GameState() {
 		// random guess at an upper bound for how many moves will go between captures. regardless it won't affect memory much at all.
 		positionHashHistory.reserve(50);
+		#ifdef ZOBRIST_VERIFICATION
+			verificationHashHistory.reserve(50);
+		#endif
 	}
 	
 	std::string toString() const {
@@ -694,12 +946,74 @@ public:
 		oss << "]\nZobrist hash: " << hash;
 		return oss.str();
 	}
-	eval_t eval() const {
+	MULTIVERSIONED eval_t eval() const {
 		if(currentPlayer) {
 			return absEval * -1;
 		}
 		return absEval;
 	}
+	// What searching the position after move at depth 0 would give, without making it: the eval for the player to move then, or -MAX_EVAL if they have no royals left.
+	// It goes through the same squares makeMove would clear and set (the range-capture line, the middle step, the source and the destination), but only adds up how their pieces' evals and royals change.
+	eval_t evalAfter(uint32_t move) const {
+		Vec2 srcPos = getMoveSrcPos(move);
+		Vec2 destPos = getMoveDestPos(move);
+		Piece piece = getSquare(srcPos);
+		uint8_t pieceOwner = piece.getOwner();
+		eval_t newAbsEval = absEval;
+		std::array<int8_t, 2> newRoyalsLeft = royalsLeft;
+		auto removePiece = [&](Piece removedPiece, Vec2 pos) {
+			if(!removedPiece) {
+				return;
+			}
+			uint8_t removedPieceOwner = removedPiece.getOwner();
+			newAbsEval -= evalPiece(removedPiece, pos) * (removedPieceOwner? -1 : 1);
+			if(removedPiece.isRoyal()) {
+				newRoyalsLeft[removedPieceOwner]--;
+			}
+		};
+		Piece capturedPiece = getSquare(destPos);
+		bool middleStepShouldPromote = false;
+		if(doesMoveRangeCapture(move)) {
+			Vec2 dir = { sign<int8_t>(destPos.x - srcPos.x), sign<int8_t>(destPos.y - srcPos.y) };
+			for(Vec2 pos = srcPos + dir; pos != destPos; pos += dir) {
+				removePiece(getSquare(pos), pos);
+			}
+		} else if(doesMoveHaveMiddleStep(move)) {
+			Vec2 middleStepPos = srcPos + getMoveMiddleStep(move);
+			removePiece(getSquare(middleStepPos), middleStepPos);
+			if(middleStepPos == destPos) {
+				capturedPiece = Piece{ 0 };
+			}
+			middleStepShouldPromote = inPromotionZone(pieceOwner, middleStepPos.y);
+		}
+		Piece movedPiece = piece;
+		if((middleStepShouldPromote || inPromotionZone(pieceOwner, destPos.y)) && piece.canPromote()) {
+			movedPiece = Piece::create(PieceTable[piece.getSpecies()].promotion, 0, pieceOwner);
+		}
+		if(srcPos != destPos) {
+			removePiece(piece, srcPos);
+		}
+		// setSquare leaves the square alone if the piece is already on it, i.e. when it steps back to where it started without promoting
+		if(movedPiece != capturedPiece) {
+			removePiece(capturedPiece, destPos);
+			newAbsEval += evalPiece(movedPiece, destPos) * (pieceOwner? -1 : 1);
+			if(movedPiece.isRoyal()) {
+				newRoyalsLeft[pieceOwner]++;
+			}
+		}
+		uint8_t nextPlayer = 1 - currentPlayer;
+		if(newRoyalsLeft[nextPlayer] == 0) {
+			return -MAX_EVAL;
+		}
+		return nextPlayer? -newAbsEval : newAbsEval;
+	}
+	// evalAfter for every move in moves, into evals. search doesn't use this, since it usually gets a cutoff after the first few moves.
+	MULTIVERSIONED void evalAfterEach(const MoveList &moves, std::vector<eval_t> &evals) const {
+		evals.resize(moves.size());
+		for(size_t i = 0; i < moves.size(); i++) {
+			evals[i] = evalAfter(moves[i]);
+		}
+	}
 	// Checks if there is a draw (by repetition), by checking if the most current game state hash is repeated 3 times earlier.
 	bool isDraw() const {
 		// not 3 like in Western chess
@@ -708,22 +1022,89 @@ public:
 			return false;
 		}
 		for(int i = positionHashHistorySize - 3; i >= 0; i -= 2) {
-			if(positionHashHistory[i] == hash && !--repetitionsToDraw) {
-				return true;
+			if(positionHashHistory[i] == hash) {
+				#ifdef ZOBRIST_VERIFICATION
+					if(verificationHashHistory[i] != verificationHash) {
+						repetitionHashCollisions++;
+						continue;
+					}
+				#endif
+				if(!--repetitionsToDraw) {
+					return true;
+				}
 			}
 		}
 		return false;
 	}
+	inline hash_t getVerificationHash() const {
+		#ifdef ZOBRIST_VERIFICATION
+			return verificationHash;
+		#else
+			return 0;
+		#endif
+	}
 	
 	inline constexpr Piece getSquare(Vec2 pos) const {
 		return board[pos.toIndex()];
 	}
+	// For copy-make: makes this the same position as other, copying the board, hashes, eval and repetition history but not the moves or the attack map.
+	// Instead the squares that are different are changed like makeMove would, so the moves that changed are regenerated from the board (if regenerateMoves). Copying into a GameState that holds a nearby position, like a sibling of other's child in search, is then about as much work as unmaking a move.
+	// A GameState has to be copied into with the same regenerateMoves every time, as its moves aren't kept up to date otherwise.
+	MULTIVERSIONED void copyPositionFrom(const GameState &other, bool regenerateMoves) {
+		// most squares are the same, so they're compared 16 at a time first, as 4 words
+		for(size_t blockI = 0; blockI < 1296; blockI += 16) {
+			uint64_t differences = 0;
+			for(size_t i = blockI; i < blockI + 16; i += 4) {
+				uint64_t squares;
+				uint64_t otherSquares;
+				std::memcpy(&squares, &board[i], sizeof(uint64_t));
+				std::memcpy(&otherSquares, &other.board[i], sizeof(uint64_t));
+				differences |= squares ^ otherSquares;
+			}
+			if(!differences) {
+				continue;
+			}
+			for(size_t i = blockI; i < blockI + 16; i++) {
+				if(board[i] == other.board[i]) {
+					continue;
+				}
+				// the square's cleared before another piece is put on it, which recalculates everything attacking it from scratch. setSquare replacing the piece directly would only patch their moves, and the copies are reused all through a search, so any mistakes in that would pile up.
+				clearSquare(Vec2::fromIndex(i), regenerateMoves);
+				if(other.board[i]) {
+					setSquare(Vec2::fromIndex(i), other.board[i], regenerateMoves);
+				}
+			}
+		}
+		if(regenerateMoves) {
+			generateMoves();
+		}
+		// setSquare and clearSquare have already got these to the same as other's, except for whose turn it is
+		moveCounter = other.moveCounter;
+		currentPlayer = other.currentPlayer;
+		royalsLeft = other.royalsLeft;
+		absEval = other.absEval;
+		hash = other.hash;
+		age = other.age;
+		positionHashHistory = other.positionHashHistory;
+		positionHashHistorySize = other.positionHashHistorySize;
+		#ifdef ZOBRIST_VERIFICATION
+			verificationHash = other.verificationHash;
+			verificationHashHistory = other.verificationHashHistory;
+		#endif
+		// moves made in it are never unmade
+		undoStack.clear();
+	}
 	inline constexpr bool playerHasPieceAtSquare(uint8_t player, Vec2 pos) const {
 		return playerOccupancyBitsets[player].contains(pos);
 	}
-	void makeMove(uint32_t move, bool regenerateMoves = true, bool saveState = false) {
-		if(saveState) {
+	// With saveState, the move is one being searched: it doesn't count towards the move counter or the age, and what's needed to unmake it is saved, unless canBeUnmade is false (copy-make never unmakes its moves).
+	MULTIVERSIONED void makeMove(uint32_t move, bool regenerateMoves = true, bool saveState = false, bool canBeUnmade = true) {
+		bool saveUndo = saveState && canBeUnmade;
+		if(saveUndo) {
 			undoStack.push_back(StaticVector<UndoSquare, 36>{});
+			MoveDeltas &moveDeltas = moveDeltaStack[undoStack.size() - 1];
+			moveDeltas.destinationChanges.clear();
+			moveDeltas.savedSquares.clear();
 		}
 		// move layout:
 		// 6 bits: src x, 6 bits: src y
@@ -748,7 +1129,7 @@ public:
 				if(!saveState && !ageShouldChange && occupancyBitset.contains(Vec2{ x, y })) {
 					ageShouldChange = true;
 				}
-				clearSquare(Vec2{ x, y }, regenerateMoves, saveState);
+				clearSquare(Vec2{ x, y }, regenerateMoves, saveUndo);
 				x += dirX;
 				y += dirY;
 			}
@@ -756,7 +1137,7 @@ public:
 			// std::cout << "log Does middle step: " << std::to_string(move) << ", " << stringifyMove(move) << std::endl;
 			Vec2 middleStep = getMoveMiddleStep(move);
 			Vec2 middleStepPos = srcPos + middleStep;
-			clearSquare(middleStepPos, regenerateMoves, saveState);
+			clearSquare(middleStepPos, regenerateMoves, saveUndo);
 			if(!saveState && occupancyBitset.contains(middleStepPos)) {
 				ageShouldChange = true;
 			}
@@ -773,85 +1154,110 @@ public:
 		
 		// std::cout << std::format("Moving piece {} from ({}, {}) to ({}, {}); capturing {}", PieceTable[piece.getSpecies()].name, srcX, srcY, destX, destY, PieceTable[getSquare(destX, destY).getSpecies()].name) << std::endl;
 		if(srcPos != destPos) {
-			clearSquare(srcPos, regenerateMoves, saveState);
+			clearSquare(srcPos, regenerateMoves, saveUndo);
 		}
 		if(!saveState && !ageShouldChange && occupancyBitset.contains(destPos)) {
 			ageShouldChange = true;
 		}
-		setSquare(destPos, piece, regenerateMoves, saveState);
+		setSquare(destPos, piece, regenerateMoves, saveUndo);
 		currentPlayer = 1 - currentPlayer;
 		hash = ~hash;
+		#ifdef ZOBRIST_VERIFICATION
+			verificationHash = ~verificationHash;
+		#endif
 		if(regenerateMoves) {
-			generateMoves();
+			generateMoves(saveUndo);
 		}
 		// captures are irreversible moves and hence the "age" of the game must be incremented
 		if(ageShouldChange) {
 			age++;
 			positionHashHistory.clear();
 			positionHashHistorySize = 0;
+			#ifdef ZOBRIST_VERIFICATION
+				verificationHashHistory.clear();
+			#endif
 		}
 		positionHashHistory.push_back(hash);
 		positionHashHistorySize++;
+		#ifdef ZOBRIST_VERIFICATION
+			verificationHashHistory.push_back(verificationHash);
+		#endif
 		
 		if(!saveState) {
 			moveCounter++;
 		}
 	}
-	void unmakeMove(bool regenerateMoves = true) {
+	// If the move regenerated moves, regenerateMoves must be true, and the moves and attacks it changed are put back from its deltas rather than regenerated
+	MULTIVERSIONED void unmakeMove(bool regenerateMoves = true) {
 		StaticVector<UndoSquare, 36> &undoSquares = undoStack.back();
+		if(regenerateMoves) {
+			restoreMoveDeltas(moveDeltaStack[undoStack.size() - 1]);
+		}
 		for(const UndoSquare &undoSquare : undoSquares) {
+			// the squares are put back without touching the moves, so the rank occupancy bitsets (which setSquare and clearSquare only update along with the moves) are updated here
+			if(regenerateMoves) {
+				if(Piece piece = getSquare(undoSquare.pos)) {
+					eraseFromRankOccupancy(undoSquare.pos, piece.getRank());
+				}
+			}
 			if(undoSquare.oldPiece) {
-				setSquare(undoSquare.pos, undoSquare.oldPiece, regenerateMoves);
+				setSquare(undoSquare.pos, undoSquare.oldPiece, false);
 			} else {
-				clearSquare(undoSquare.pos, regenerateMoves);
+				clearSquare(undoSquare.pos, false);
+			}
+			if(regenerateMoves) {
+				if(Piece piece = getSquare(undoSquare.pos)) {
+					insertIntoRankOccupancy(undoSquare.pos, piece.getRank());
+				}
 			}
 		}
 		undoStack.pop_back();
-		if(regenerateMoves) {
-			generateMoves();
-		}
 		currentPlayer = 1 - currentPlayer;
 		hash = ~hash;
 		positionHashHistory.pop_back();
 		positionHashHistorySize--;
+		#ifdef ZOBRIST_VERIFICATION
+			verificationHash = ~verificationHash;
+			verificationHashHistory.pop_back();
+		#endif
 	}
 	
-	template <bool slideIsRangeCapturing, std::invocable<Vec2> F, std::invocable<Vec2> J>
-	void generateSlideMoves(Vec2 src, Slide slide, uint8_t pieceOwner, uint8_t pieceRank, F &&insertIntoAttackingSquares, J &&insertIntoMoveLocations) {
+	// Slides are stepped a square at a time in every direction. Sideways slides could find their blocker with a bit scan, since a row's squares are a contiguous run of bits, but that only measured clearly faster on boards with lots of long open rows. It was slower on the opening and the back ranks, and no better overall on midgame positions.
+	template <bool slideIsRangeCapturing>
+	[[gnu::always_inline]] inline void generateSlideMoves(Vec2 src, Slide slide, uint8_t pieceOwner, uint8_t pieceRank, BoardPosBitset &attackingSquares, BoardPosBitset &moveLocations) {
 		Vec2 slideDir = movementDirToBoardDir(slide.dir, pieceOwner);
 		uint8_t distToEdgeOfBoard = std::min(slideDir.x? slideDir.x > 0? (35 - src.x) / slideDir.x : -src.x / slideDir.x : 35, slideDir.y? slideDir.y > 0? (35 - src.y) / slideDir.y : -src.y / slideDir.y : 35);
 		uint8_t maxDist = std::min(slide.range, distToEdgeOfBoard);
 		Vec2 target = src;
 		if constexpr(slideIsRangeCapturing) {
+			// range-capturing pieces jump over anything of a lower rank
+			const BoardPosBitset &blockers = rankOccupancyBitsets[pieceRank - 1];
 			for(uint8_t dist = 0; dist < maxDist; dist++) {
 				target += slideDir;
-				insertIntoAttackingSquares(target);
-				if(occupancyBitset.contains(target)) {
-					bool isBlocked = getSquare(target).getRank() >= pieceRank;
-					if(isBlocked) {
-						break;
-					}
+				attackingSquares.insert(target);
+				if(blockers.contains(target)) {
+					break;
 				}
-				insertIntoMoveLocations(target);
+				moveLocations.insert(target);
 			}
 		} else {
 			for(uint8_t dist = 0; dist < maxDist; dist++) {
 				target += slideDir;
-				insertIntoAttackingSquares(target);
+				attackingSquares.insert(target);
 				if(occupancyBitset.contains(target)) {
 					bool isBlocked = playerOccupancyBitsets[pieceOwner].contains(target);
 					if(!isBlocked) {
-						insertIntoMoveLocations(target);
+						moveLocations.insert(target);
 					}
 					break;
 				} else {
-					insertIntoMoveLocations(target);
+					moveLocations.insert(target);
 				}
 			}
 		}
 	}
 	template <std::invocable<Vec2> F, std::invocable<Vec2> J>
-	void generateJumpMoves(Vec2 src, Vec2 jump, uint8_t pieceOwner, F &&insertIntoAttackingSquares, J &&insertIntoMoveLocations, Vec2 definitelyEmptyLocation = { -1, -1 }) {
+	[[gnu::always_inline]] inline void generateJumpMoves(Vec2 src, Vec2 jump, uint8_t pieceOwner, F &&insertIntoAttackingSquares, J &&insertIntoMoveLocations, Vec2 definitelyEmptyLocation = { -1, -1 }) {
 		Vec2 target = src + movementDirToBoardDir(jump, pieceOwner);
 		if(isPosWithinBounds(target)) {
 			insertIntoAttackingSquares(target);
@@ -861,7 +1267,7 @@ public:
 		}
 	}
 	template <std::invocable<Vec2> F, std::invocable<Vec2> J>
-	void generateTripleSlashedArrowMoves(Vec2 src, Vec2 tripleSlashedArrowDir, uint8_t pieceOwner, F &&insertIntoAttackingSquares, J &&insertIntoMoveLocations) {
+	[[gnu::always_inline]] inline void generateTripleSlashedArrowMoves(Vec2 src, Vec2 tripleSlashedArrowDir, uint8_t pieceOwner, F &&insertIntoAttackingSquares, J &&insertIntoMoveLocations) {
 		Vec2 dir = movementDirToBoardDir(tripleSlashedArrowDir, pieceOwner);
 		uint8_t jumpsRemaining = 4; // it will be decremented first before being checked, so this will make it trigger on the fourth jump
 		uint8_t distToEdgeOfBoard = std::min(dir.x? dir.x > 0? 35 - src.x : src.x : 35, dir.y? dir.y > 0? 35 - src.y : src.y : 35);
@@ -882,127 +1288,313 @@ public:
 			}
 		}
 	}
-	void generateMoves() {
-		squaresNeedingMoveRecalculation.forEachAndClear([this](size_t srcI) {
-			movesPerSquarePerPlayer[0][srcI].clear();
-			movesPerSquarePerPlayer[1][srcI].clear();
-			Vec2 src = Vec2::fromIndex(srcI);
-			Piece piece = getSquare(src);
-			uint8_t pieceOwner = piece.getOwner();
-			bool pieceIsRangeCapturing = isRangeCapturingPiece(piece.getSpecies());
-			uint8_t pieceRank = piece.getRank();
-			if(piece) {
-				const Movements &movements = PieceTable[piece.getSpecies()].movements;
-				BoardPosBitset attackingSquares;
-				BoardPosBitset validMoveLocations;
-				BoardPosBitset rangeCapturingMoveLocations;
-				for(const Slide &slide : movements.slides) {
-					bool slideIsRangeCapturing = pieceIsRangeCapturing && slide.range == 35;
-					if(slideIsRangeCapturing) {
-						generateSlideMoves<true>(src, slide, pieceOwner, pieceRank, [&](Vec2 pos) {
-							attackingSquares.insert(pos);
-						}, [&](Vec2 pos) {
-							rangeCapturingMoveLocations.insert(pos);
-						});
-					} else {
-						generateSlideMoves<false>(src, slide, pieceOwner, pieceRank, [&](Vec2 pos) {
-							attackingSquares.insert(pos);
-						}, [&](Vec2 pos) {
-							validMoveLocations.insert(pos);
-						});
-					}
+	// Generates all of a piece's area moves (see areaMoves.h) from the own pieces and edges of the board around it. Their destinations are stored separately in areaMoveDestinations, since they depend on the middle step.
+	MULTIVERSIONED void generateAreaMoves(PieceSpecies::Type species, uint8_t pieceOwner, Vec2 src, size_t srcI, BoardPosBitset &attackingSquares, BoardPosBitset &validMoveLocations) {
+		uint32_t offBoardArea = areaMoveTables.offBoardAreas[srcI];
+		uint32_t ownArea = getArea(playerOccupancyBitsets[pieceOwner], src) & ~offBoardArea;
+		// the piece can always move back to where it started
+		uint32_t blockedSecondStepArea = offBoardArea | (ownArea & ~(1u << AREA_CENTER_BIT));
+		uint32_t attackedArea = 0;
+		uint32_t firstStepMoveArea = 0;
+		MovementSpan compoundMoveSpan = movementTables.compoundMoveSpans[species];
+		AreaMoveDestinations &destinations = areaMoveDestinations[srcI];
+		for(size_t compoundMoveI = compoundMoveSpan.offset; compoundMoveI < compoundMoveSpan.offset + compoundMoveSpan.count; compoundMoveI++) {
+			if(!areaMoveTables.isAreaMove[compoundMoveI]) {
+				continue;
+			}
+			const AreaMove &areaMove = areaMoveTables.areaMoves[compoundMoveI][pieceOwner];
+			for(size_t i = 0; i < areaMove.firstStepCount; i++) {
+				uint32_t firstStep = 1u << areaMove.firstStepBits[i];
+				if(offBoardArea & firstStep) {
+					continue;
 				}
-				for(const Vec2 &jump : movements.jumps) {
-					// arghh lambdas are so janky
-					generateJumpMoves(src, jump, pieceOwner, [&](Vec2 pos) {
-						attackingSquares.insert(pos);
-					}, [&](Vec2 pos) {
-						validMoveLocations.insert(pos);
-					});
+				attackedArea |= firstStep;
+				if(ownArea & firstStep) {
+					continue;
+				}
+				firstStepMoveArea |= firstStep;
+				uint32_t secondStepArea = areaMove.secondStepAreas[i] & ~offBoardArea;
+				attackedArea |= secondStepArea;
+				uint32_t secondStepMoveArea = secondStepArea & ~blockedSecondStepArea;
+				if(secondStepMoveArea) {
+					destinations.firstStepBits[destinations.count] = areaMove.firstStepBits[i];
+					destinations.secondStepAreas[destinations.count] = secondStepMoveArea;
+					destinations.count++;
 				}
-				for(const Vec2 &tripleSlashedArrowDir : movements.tripleSlashedArrowDirs) {
-					generateTripleSlashedArrowMoves(src, tripleSlashedArrowDir, pieceOwner, [&](Vec2 pos) {
+			}
+		}
+		insertArea(attackingSquares, src, attackedArea);
+		insertArea(validMoveLocations, src, firstStepMoveArea);
+	}
+	// Generates a piece's attacks and moves from the movement tables. Compound moves with a middle step go straight into the square's move list.
+	// It's always inlined: into interpretPieceMoves, and into generateSpeciesMoves (in SPECIES_MOVE_GENERATORS builds), where species and pieceOwner are constants and so every loop over the tables unrolls with its directions and ranges as constants.
+	[[gnu::always_inline]] inline void generatePieceMoves(PieceSpecies::Type species, uint8_t pieceOwner, Vec2 src, size_t srcI, BoardPosBitset &attackingSquares, BoardPosBitset &validMoveLocations) {
+		bool pieceIsRangeCapturing = movementTables.flags[species] & SPECIES_RANGE_CAPTURING;
+		uint8_t pieceRank = movementTables.flags[species] & SPECIES_RANK_MASK;
+		for(const Slide &slide : movementTables.getSlides(species)) {
+			bool slideIsRangeCapturing = pieceIsRangeCapturing && slide.range == 35;
+			if(slideIsRangeCapturing) {
+				generateSlideMoves<true>(src, slide, pieceOwner, pieceRank, attackingSquares, validMoveLocations);
+			} else {
+				generateSlideMoves<false>(src, slide, pieceOwner, pieceRank, attackingSquares, validMoveLocations);
+			}
+		}
+		if(const BoardPosBitset *jumpTargets = jumpTargetTable.get(species, pieceOwner, srcI)) {
+			attackingSquares |= *jumpTargets;
+			validMoveLocations.insertAllExcept(*jumpTargets, playerOccupancyBitsets[pieceOwner]);
+		}
+		for(const Vec2 &tripleSlashedArrowDir : movementTables.getTripleSlashedArrowDirs(species)) {
+			generateTripleSlashedArrowMoves(src, tripleSlashedArrowDir, pieceOwner, [&](Vec2 pos) {
+				attackingSquares.insert(pos);
+			}, [&](Vec2 pos) {
+				validMoveLocations.insert(pos);
+			});
+		}
+		if(areaMoveTables.hasAreaMoves[species]) {
+			generateAreaMoves(species, pieceOwner, src, srcI, attackingSquares, validMoveLocations);
+		}
+		MovementSpan compoundMoveSpan = movementTables.compoundMoveSpans[species];
+		for(size_t compoundMoveI = compoundMoveSpan.offset; compoundMoveI < compoundMoveSpan.offset + compoundMoveSpan.count; compoundMoveI++) {
+			if(areaMoveTables.isAreaMove[compoundMoveI]) {
+				continue;
+			}
+			const FlatCompoundMove &compoundMove = movementTables.compoundMoves[compoundMoveI];
+			// the most any first step can reach is two full-length slides
+			StaticVector<Vec2, 72> step2StartPositions;
+			if(compoundMove.firstStepSlides.count) {
+				BoardPosBitset firstStepMoveLocations;
+				for(const Slide &slide : movementTables.getSlides(compoundMove.firstStepSlides)) {
+					generateSlideMoves<false>(src, slide, pieceOwner, pieceRank, attackingSquares, firstStepMoveLocations);
+				}
+				validMoveLocations |= firstStepMoveLocations;
+				// the second step can only start from empty squares
+				firstStepMoveLocations.bitTransformForEach(occupancyBitset, [](uint64_t moveLocations, uint64_t occupied) {
+					return moveLocations & ~occupied;
+				}, [&](size_t i) {
+					step2StartPositions.push_back(Vec2::fromIndex(i));
+				});
+			}
+			for(const Vec2 &jump : movementTables.getJumps(compoundMove.firstStepJumps)) {
+				// arghh lambdas are so janky
+				generateJumpMoves(src, jump, pieceOwner, [&](Vec2 pos) {
+					attackingSquares.insert(pos);
+				}, [&](Vec2 pos) {
+					validMoveLocations.insert(pos);
+					// lion-like pieces (and the free eagle) can capture on the first step then move again. it's always a jump.
+					if(compoundMove.canContinueAfterCapture || !occupancyBitset.contains(pos)) {
+						step2StartPositions.push_back(pos);
+					}
+				});
+			}
+			
+			for(const Vec2 &step2StartPos : step2StartPositions) {
+				for(const Slide &slide : movementTables.getSlides(compoundMove.secondStepSlides)) {
+					generateSlideMoves<false>(step2StartPos, slide, pieceOwner, pieceRank, attackingSquares, validMoveLocations);
+				}
+				// compound moves which can capture on the first step are all area moves, so these never need their middle step
+				for(const Vec2 &jump : movementTables.getJumps(compoundMove.secondStepJumps)) {
+					generateJumpMoves(step2StartPos, jump, pieceOwner, [&](Vec2 pos) {
 						attackingSquares.insert(pos);
 					}, [&](Vec2 pos) {
 						validMoveLocations.insert(pos);
-					});
+					}, src);
 				}
-				for(const CompoundMove &compoundMove : movements.compoundMoves) {
-					std::vector<Vec2> step2StartPositions;
-					for(const Slide &slide : compoundMove.firstStep.slides) {
-						generateSlideMoves<false>(src, slide, pieceOwner, pieceRank, [&](Vec2 pos) {
-							attackingSquares.insert(pos);
-						}, [&](Vec2 pos) {
-							validMoveLocations.insert(pos);
-							if(!occupancyBitset.contains(pos)) {
-								step2StartPositions.push_back(pos);
-							}
-						});
-					}
-					for(const Vec2 &jump : compoundMove.firstStep.jumps) {
-						// arghh lambdas are so janky
-						generateJumpMoves(src, jump, pieceOwner, [&](Vec2 pos) {
-							attackingSquares.insert(pos);
-						}, [&](Vec2 pos) {
-							validMoveLocations.insert(pos);
-							// lion-like pieces (and the free eagle) can capture on the first step then move again. it's always a jump.
-							if(compoundMove.firstStep.canContinueAfterCapture || !occupancyBitset.contains(pos)) {
-								step2StartPositions.push_back(pos);
-							}
-						});
-					}
-					
-					for(const Vec2 &step2StartPos : step2StartPositions) {
-						for(const Slide &slide : compoundMove.secondStep.slides) {
-							generateSlideMoves<false>(step2StartPos, slide, pieceOwner, pieceRank, [&](Vec2 pos) {
-								attackingSquares.insert(pos);
-							}, [&](Vec2 pos) {
-								validMoveLocations.insert(pos);
-							});
-						}
-						BoardPosBitset moveWithMiddleStepPositions;
-						for(const Vec2 &jump : compoundMove.secondStep.jumps) {
-							generateJumpMoves(step2StartPos, jump, pieceOwner, [&](Vec2 pos) {
-								attackingSquares.insert(pos);
-							}, [&](Vec2 pos) {
-								if(compoundMove.firstStep.canContinueAfterCapture) {
-									moveWithMiddleStepPositions.insert(pos);
-								} else {
-									validMoveLocations.insert(pos);
-								}
-							}, src);
-						}
-						moveWithMiddleStepPositions.transformInto(movesPerSquarePerPlayer[pieceOwner][srcI], [&](Vec2 target) {
-							return createMove(src, target, false, true, step2StartPos - src);
-						});
+			}
+		}
+	}
+	MULTIVERSIONED void interpretPieceMoves(Piece piece, Vec2 src, size_t srcI, BoardPosBitset &attackingSquares, BoardPosBitset &validMoveLocations) {
+		generatePieceMoves(piece.getSpecies(), piece.getOwner(), src, srcI, attackingSquares, validMoveLocations);
+	}
+	#ifdef SPECIES_MOVE_GENERATORS
+		template <PieceSpecies::Type species, uint8_t pieceOwner>
+		void generateSpeciesMoves(Vec2 src, size_t srcI, BoardPosBitset &attackingSquares, BoardPosBitset &validMoveLocations) {
+			generatePieceMoves(species, pieceOwner, src, srcI, attackingSquares, validMoveLocations);
+		}
+		using SpeciesMoveGenerator = void (GameState::*)(Vec2, size_t, BoardPosBitset&, BoardPosBitset&);
+		// [species][owner]
+		static const std::array<std::array<SpeciesMoveGenerator, 2>, 302> speciesMoveGenerators;
+	#endif
+	
+	// With saveDeltas, each square's moves and attacks are saved to the current move's deltas before they're regenerated
+	MULTIVERSIONED void generateMoves(bool saveDeltas = false) {
+		squaresNeedingMoveRecalculation.forEachAndClear([this, saveDeltas](size_t srcI) {
+			Vec2 src = Vec2::fromIndex(srcI);
+			Piece piece = getSquare(src);
+			BoardPosBitset &validMoveLocations = moveDestinations[srcI];
+			if(saveDeltas) {
+				moveDeltaStack[undoStack.size() - 1].savedSquares.push_back({ static_cast<uint16_t>(srcI), squaresWithMoves.contains(srcI), moveDestinationWords[srcI], areaMoveDestinations[srcI], bidirectionalAttackMap.getAttacks(srcI), validMoveLocations });
+			}
+			validMoveLocations.clear();
+			areaMoveDestinations[srcI].count = 0;
+			if(piece) {
+				BoardPosBitset attackingSquares;
+				#ifdef SPECIES_MOVE_GENERATORS
+					if(useSpeciesMoveGenerators) {
+						(this->*speciesMoveGenerators[piece.getSpecies()][piece.getOwner()])(src, srcI, attackingSquares, validMoveLocations);
+					} else {
+						interpretPieceMoves(piece, src, srcI, attackingSquares, validMoveLocations);
 					}
-				}
+				#else
+					interpretPieceMoves(piece, src, srcI, attackingSquares, validMoveLocations);
+				#endif
 				
 				bidirectionalAttackMap.setAttacks(srcI, attackingSquares);
-				rangeCapturingMoveLocations.transformInto(movesPerSquarePerPlayer[pieceOwner][srcI], [src](const Vec2 &target) {
-					return createMove(src, target, true);
-				});
-				validMoveLocations.transformInto(movesPerSquarePerPlayer[pieceOwner][srcI], [src](const Vec2 &target) {
-					return createMove(src, target);
-				});
+				moveDestinationWords[srcI] = validMoveLocations.getNonEmptyWords();
+				if(moveDestinationWords[srcI] || areaMoveDestinations[srcI].count) {
+					squaresWithMoves.insert(srcI);
+				} else {
+					squaresWithMoves.erase(srcI);
+				}
 			} else {
 				bidirectionalAttackMap.clearAttacks(srcI);
+				moveDestinationWords[srcI] = 0;
+				squaresWithMoves.erase(srcI);
 			}
 		});
 	}
-	std::vector<uint32_t> getAllMovesForPlayer(uint8_t player) {
-		size_t totalSpace = 0;
-		for(const std::vector<uint32_t> &moves : movesPerSquarePerPlayer[player]) {
-			totalSpace += moves.size();
+	// Puts back the moves and attacks a move changed, undoing its deltas in reverse order
+	MULTIVERSIONED void restoreMoveDeltas(const MoveDeltas &moveDeltas) {
+		for(auto it = moveDeltas.savedSquares.rbegin(); it != moveDeltas.savedSquares.rend(); it++) {
+			const SavedSquareMoves &saved = *it;
+			bidirectionalAttackMap.setAttacks(saved.srcI, saved.attacks);
+			moveDestinations[saved.srcI] = saved.moveDestinations;
+			moveDestinationWords[saved.srcI] = saved.moveDestinationWords;
+			areaMoveDestinations[saved.srcI] = saved.areaMoveDestinations;
+			if(saved.hadMoves) {
+				squaresWithMoves.insert(saved.srcI);
+			} else {
+				squaresWithMoves.erase(saved.srcI);
+			}
 		}
-		// std::cout << "log Space for " << totalSpace << " moves"<<std::endl;
-		
-		std::vector<uint32_t> allMoves;
-		allMoves.reserve(totalSpace);
-		for(const std::vector<uint32_t> &moves : movesPerSquarePerPlayer[player]) {
-			allMoves.insert(allMoves.end(), moves.begin(), moves.end());
+		for(auto it = moveDeltas.destinationChanges.rbegin(); it != moveDeltas.destinationChanges.rend(); it++) {
+			const MoveDestinationChange &change = *it;
+			if(change.wasAdded) {
+				moveDestinations[change.srcI].erase(change.destI);
+			} else {
+				moveDestinations[change.srcI].insert(change.destI);
+			}
+			moveDestinationWords[change.srcI] = change.moveDestinationWords;
+			if(change.hadMoves) {
+				squaresWithMoves.insert(change.srcI);
+			} else {
+				squaresWithMoves.erase(change.srcI);
+			}
 		}
-		
+	}
+	// Every square a player's plain slides attack (not the slides in compound moves), worked out for all of their pieces at once with flood fills (see floodFill.h) rather than ray by ray.
+	// It needs the rank occupancy bitsets for range-capturing slides, so like the attack map it's only right when moves have been regenerated.
+	MULTIVERSIONED BoardPosBitset getSlideAttacks(uint8_t player) const {
+		std::array<BoardPosBitset, FloodFill::MAX_SLIDE_GROUPS> groupSliders;
+		std::array<uint64_t, FloodFill::MAX_SLIDE_GROUPS / 64> usedGroups{};
+		playerOccupancyBitsets[player].forEach([&](size_t srcI) {
+			MovementSpan slideSpan = movementTables.slideSpans[board[srcI].getSpecies()];
+			for(size_t slideI = slideSpan.offset; slideI < slideSpan.offset + slideSpan.count; slideI++) {
+				uint8_t group = FloodFill::slideGroupTables.slideGroups[slideI][player];
+				groupSliders[group].insert(srcI);
+				usedGroups[group >> 6] |= 1ULL << (group & 63);
+			}
+		});
+		BoardPosBitset emptySquares = FloodFill::ALL_SQUARES ^ occupancyBitset;
+		BoardPosBitset attacks;
+		for(size_t wordIndex = 0; wordIndex < usedGroups.size(); wordIndex++) {
+			for(uint64_t word = usedGroups[wordIndex]; word; word &= word - 1) {
+				size_t group = (wordIndex << 6) + std::countr_zero(word);
+				const FloodFill::SlideGroup &slideGroup = FloodFill::slideGroupTables.groups[group];
+				if(slideGroup.rangeCapturingRank) {
+					// range-capturing pieces jump over anything of a lower rank
+					attacks |= FloodFill::slideAttacks(groupSliders[group], FloodFill::ALL_SQUARES ^ rankOccupancyBitsets[slideGroup.rangeCapturingRank - 1], slideGroup.dir, slideGroup.range);
+				} else {
+					attacks |= FloodFill::slideAttacks(groupSliders[group], emptySquares, slideGroup.dir, slideGroup.range);
+				}
+			}
+		}
+		return attacks;
+	}
+	// The same as getSlideAttacks, but walking every piece's rays one by one like move generation does, to check it against and benchmark it with
+	BoardPosBitset getSlideAttacksRayByRay(uint8_t player) {
+		BoardPosBitset attacks;
+		BoardPosBitset moveLocations;
+		playerOccupancyBitsets[player].forEach([&](size_t srcI) {
+			PieceSpecies::Type species = board[srcI].getSpecies();
+			bool pieceIsRangeCapturing = movementTables.flags[species] & SPECIES_RANGE_CAPTURING;
+			uint8_t pieceRank = movementTables.flags[species] & SPECIES_RANK_MASK;
+			for(const Slide &slide : movementTables.getSlides(species)) {
+				if(pieceIsRangeCapturing && slide.range == 35) {
+					generateSlideMoves<true>(Vec2::fromIndex(srcI), slide, player, pieceRank, attacks, moveLocations);
+				} else {
+					generateSlideMoves<false>(Vec2::fromIndex(srcI), slide, player, pieceRank, attacks, moveLocations);
+				}
+			}
+		});
+		return attacks;
+	}
+	// Recalculates every piece's moves from scratch, for benchmarking move generation. Returns how many pieces there are.
+	size_t regenerateAllMoves() {
+		squaresNeedingMoveRecalculation = occupancyBitset;
+		generateMoves();
+		return occupancyBitset.size();
+	}
+	// Fills allMoves in place, so passing in the same list every time means it stops allocating once it's grown big enough
+	// The moves are written straight into allMoves rather than pushed back one by one, with destination bitsets expanded into moves a register at a time (see BoardPosBitset::expandInto). Room is made for each piece's moves before they're written, without initialising it, and then the list is extended to just the moves there are.
+	MULTIVERSIONED void getAllMovesForPlayer(uint8_t player, MoveList &allMoves) {
+		allMoves.clear();
+		auto makeRoomFor = [&](size_t count) {
+			return allMoves.makeRoomFor(count + BoardPosBitset::EXPANSION_SLACK);
+		};
+		// only squares with the player's pieces on them have moves, and lots of pieces can't move at all, so there's no need to look at the rest of the board
+		playerOccupancyBitsets[player].bitTransformForEach(squaresWithMoves, [](uint64_t playerOccupied, uint64_t withMoves) {
+			return playerOccupied & withMoves;
+		}, [&](size_t srcI) {
+			Vec2 src = Vec2::fromIndex(srcI);
+			const AreaMoveDestinations &areaMoves = areaMoveDestinations[srcI];
+			for(size_t i = 0; i < areaMoves.count; i++) {
+				Vec2 middleStep = fromAreaBit(areaMoves.firstStepBits[i]);
+				uint32_t secondStepArea = areaMoves.secondStepAreas[i];
+				uint32_t *moveEnd = makeRoomFor(std::popcount(secondStepArea));
+				while(secondStepArea) {
+					*moveEnd++ = createMove(src, src + fromAreaBit(std::countr_zero(secondStepArea)), false, true, middleStep);
+					secondStepArea &= secondStepArea - 1;
+				}
+				allMoves.setEnd(moveEnd);
+			}
+			uint32_t *moveEnd = makeRoomFor(moveDestinations[srcI].sizeInWords(moveDestinationWords[srcI]));
+			if(board[srcI].isRangeCapturing()) {
+				// none of their other moves are along the same lines as their range-capturing slides, so those lines pick out the range-capturing moves
+				uint8_t speciesFlags = movementTables.flags[board[srcI].getSpecies()];
+				BoardPosBitset rangeCapturingLines;
+				if(speciesFlags & SPECIES_RANGE_CAPTURES_ORTHOGONALLY) {
+					rangeCapturingLines |= BOARD_LINES.rows[src.y] | BOARD_LINES.columns[src.x];
+				}
+				if(speciesFlags & SPECIES_RANGE_CAPTURES_DIAGONALLY) {
+					rangeCapturingLines |= BOARD_LINES.diagonals[src.x - src.y + 35] | BOARD_LINES.antidiagonals[src.x + src.y];
+				}
+				BoardPosBitset rangeCapturingDestinations = moveDestinations[srcI] & rangeCapturingLines;
+				BoardPosBitset otherDestinations = moveDestinations[srcI] ^ rangeCapturingDestinations;
+				moveEnd = rangeCapturingDestinations.expandInto(moveEnd, MOVE_DESTINATIONS, createMove(src, { 0, 0 }, true), rangeCapturingDestinations.getNonEmptyWords());
+				moveEnd = otherDestinations.expandInto(moveEnd, MOVE_DESTINATIONS, createMove(src, { 0, 0 }), moveDestinationWords[srcI]);
+			} else {
+				moveEnd = moveDestinations[srcI].expandInto(moveEnd, MOVE_DESTINATIONS, createMove(src, { 0, 0 }), moveDestinationWords[srcI]);
+			}
+			allMoves.setEnd(moveEnd);
+		});
+	}
+	// The same as getAllMovesForPlayer(player).size(), but just counts the bits in the destination bitsets, for perft
+	MULTIVERSIONED size_t countMovesForPlayer(uint8_t player) const {
+		size_t moveCount = 0;
+		playerOccupancyBitsets[player].bitTransformForEach(squaresWithMoves, [](uint64_t playerOccupied, uint64_t withMoves) {
+			return playerOccupied & withMoves;
+		}, [&](size_t srcI) {
+			const AreaMoveDestinations &areaMoves = areaMoveDestinations[srcI];
+			for(size_t i = 0; i < areaMoves.count; i++) {
+				moveCount += std::popcount(areaMoves.secondStepAreas[i]);
+			}
+			moveCount += moveDestinations[srcI].sizeInWords(moveDestinationWords[srcI]);
+		});
+		return moveCount;
+	}
+	MoveList getAllMovesForPlayer(uint8_t player) {
+		MoveList allMoves;
+		getAllMovesForPlayer(player, allMoves);
 		return allMoves;
 	}
 	
@@ -1012,7 +1604,7 @@ public:
 			for(int8_t x = 0; x < 36; x++) {
 				Piece piece = getSquare(Vec2{ x, y });
 				if(piece) {
-					std::string pieceName = PieceTable[piece.getSpecies()].name;
+					std::string pieceName(PieceTable[piece.getSpecies()].name);
 					tsfen += piece.getOwner()? pieceName : lowercaseString(pieceName);
 				} else {
 					tsfen += "1";
@@ -1077,6 +1669,14 @@ public:
 inline constexpr std::string_view INITIAL_TSFEN = {
 	#include "initialTsfen.inc"
 };
+#ifdef SPECIES_MOVE_GENERATORS
+	inline constexpr std::array<std::array<GameState::SpeciesMoveGenerator, 2>, 302> GameState::speciesMoveGenerators = []<size_t... species>(std::index_sequence<species...>) {
+		return std::array<std::array<SpeciesMoveGenerator, 2>, 302>{ {
+			{ &GameState::generateSpeciesMoves<static_cast<PieceSpecies::Type>(species), 0>, &GameState::generateSpeciesMoves<static_cast<PieceSpecies::Type>(species), 1> }...
+		} };
+	}(std::make_index_sequence<302>{});
+#endif
+
 inline GameState initialGameState = GameState::fromTsfen(INITIAL_TSFEN);
 
 Vec2 parseBoardPos(std::string boardPos) {
@@ -1091,8 +1691,8 @@ uint32_t parseMove(GameState &gameState, std::vector<std::string> arguments) {
 	auto destPos = parseBoardPos(arguments[2]);
 	Piece movingPiece = gameState.getSquare(srcPos);
 	bool isRangeCapturingMove = false;
-	if(isRangeCapturingPiece(movingPiece.getSpecies())) {
-		auto &slides = PieceTable[movingPiece.getSpecies()].movements.slides;
+	if(movingPiece.isRangeCapturing()) {
+		auto slides = movementTables.getSlides(movingPiece.getSpecies());
 		Vec2 deltaPos = destPos - srcPos;
 		Vec2 slideDir = { sign(deltaPos.x), sign(deltaPos.y) };
 		for(const auto &slide : slides) {
@@ -1117,7 +1717,14 @@ uint32_t parseMove(GameState &gameState, std::vector<std::string> arguments) {
 uint64_t totalNodesSearched = 0;
 uint32_t nodesSearched = 0;
 
-eval_t search(GameState &gameState, eval_t alpha, eval_t beta, depth_t depth) {
+// whether search makes each move in a copy of the position (see GameState::copyPositionFrom) rather than making and unmaking it in place. can be switched with the `makemode` command, and copymakebench compares them.
+bool useCopyMake = false;
+// [depth]: the positions search makes moves in at each depth with copy-make. they're reused from node to node, so each one holds a position close to the next one copied into it.
+std::array<GameState, MAX_DEPTH> copyMakeStates;
+// move lists for search and perft, one per depth so that they're reused from node to node instead of being allocated each time
+std::array<MoveList, MAX_DEPTH + 1> moveBuffers;
+
+MULTIVERSIONED eval_t search(GameState &gameState, eval_t alpha, eval_t beta, depth_t depth) {
 	nodesSearched++;
 	// checking royal pieces only needs to be done for the current player - no point checking the player who just moved
 	if(gameState.royalsLeft[gameState.currentPlayer] == 0) {
@@ -1129,7 +1736,10 @@ eval_t search(GameState &gameState, eval_t alpha, eval_t beta, depth_t depth) {
 	if(gameState.isDraw()) {
 		return 0;
 	}
-	TranspositionTableEntry* ttEntry = transpositionTable.get(gameState.hash);
+	TranspositionTableEntry* ttEntry = transpositionTable.get(gameState.hash, gameState.getVerificationHash());
+	if(ttEntry) {
+		transpositionTable.recordProbeResult(*ttEntry, depth, alpha, beta);
+	}
 	// this makes it look at more nodes somehow... and there are hash collisions still... so I don't really trust it
 	// also it doesn't account for repetition draws so ends up in infinite loops
 	
@@ -1138,7 +1748,8 @@ eval_t search(GameState &gameState, eval_t alpha, eval_t beta, depth_t depth) {
 	// 		return ttEntry->eval;
 	// 	}
 	// }
-	std::vector<uint32_t> moves = gameState.getAllMovesForPlayer(gameState.currentPlayer);
+	MoveList &moves = moveBuffers[depth];
+	gameState.getAllMovesForPlayer(gameState.currentPlayer, moves);
 	// std::cout << "log Found " << moves.size() << " moves" << std::endl;
 	bool hasTtMove = ttEntry;
 	uint32_t ttMove = hasTtMove? ttEntry->bestMove : 0;
@@ -1154,6 +1765,9 @@ eval_t search(GameState &gameState, eval_t alpha, eval_t beta, depth_t depth) {
 			moves[hasTtMove + 1] = killerMoves[1][depth];
 		}
 	}
+	if(hasTtMove && (moves.empty() || moves[0] != ttMove)) {
+		transpositionTable.recordMoveCollision();
+	}
 	
 	eval_t originalAlpha = alpha;
 	// Must have -1 at the end so even if all moves lead to loss (and hence the best is -MAX_EVAL), it will store a move rather than nothing at all.
@@ -1161,18 +1775,33 @@ eval_t search(GameState &gameState, eval_t alpha, eval_t beta, depth_t depth) {
 	uint32_t bestMove = 0;
 	bool foundPvNode = 0;
 	bool regenerateMoves = depth > 1;
+	// the moves at depth 1 all lead to leaves, so rather than making each of them to get its eval, they're scored without being made
+	bool childrenAreLeaves = depth == 1;
 	for(uint32_t move : moves) {
-		gameState.makeMove(move, regenerateMoves, true);
 		eval_t score;
-		if(!foundPvNode) {
-			score = -search(gameState, -beta, -alpha, depth - 1);
+		if(childrenAreLeaves) {
+			// the same as searching the child, which counts as a node each time it's searched: once, or twice if the null window search needs redoing
+			score = -gameState.evalAfter(move);
+			nodesSearched += 1 + (foundPvNode && score > alpha && score < beta);
 		} else {
-			score = -search(gameState, -alpha - 1, -alpha, depth - 1);
-			if(score > alpha && score < beta) {
-				score = -search(gameState, -beta, -alpha, depth - 1);
+			GameState *child = &gameState;
+			if(useCopyMake) {
+				child = &copyMakeStates[depth - 1];
+				child->copyPositionFrom(gameState, regenerateMoves);
+			}
+			child->makeMove(move, regenerateMoves, true, !useCopyMake);
+			if(!foundPvNode) {
+				score = -search(*child, -beta, -alpha, depth - 1);
+			} else {
+				score = -search(*child, -alpha - 1, -alpha, depth - 1);
+				if(score > alpha && score < beta) {
+					score = -search(*child, -beta, -alpha, depth - 1);
+				}
+			}
+			if(!useCopyMake) {
+				gameState.unmakeMove(regenerateMoves);
 			}
 		}
-		gameState.unmakeMove(regenerateMoves);
 		if(score > bestScore) {
 			bestScore = score;
 			bestMove = move;
@@ -1190,10 +1819,10 @@ eval_t search(GameState &gameState, eval_t alpha, eval_t beta, depth_t depth) {
 		}
 	}
 	NodeType nodeType = bestScore <= originalAlpha? NodeType::UPPER_BOUND : bestScore >= beta? NodeType::LOWER_BOUND : NodeType::EXACT;
-	transpositionTable.put(gameState.hash, bestMove, depth, gameState.age, bestScore, nodeType);
+	transpositionTable.put(gameState.hash, gameState.getVerificationHash(), bestMove, depth, gameState.age, bestScore, nodeType);
 	return bestScore;
 }
-uint32_t perft(GameState &gameState, depth_t depth) {
+MULTIVERSIONED uint64_t perft(GameState &gameState, depth_t depth) {
 	// checking royal pieces only needs to be done for the current player - no point checking the player who just moved
 	if(gameState.royalsLeft[gameState.currentPlayer] == 0) {
 		return 1;
@@ -1204,45 +1833,235 @@ uint32_t perft(GameState &gameState, depth_t depth) {
 	if(gameState.isDraw()) {
 		return 1;
 	}
-	uint32_t nodesSearched = 0;
-	std::vector<uint32_t> moves = gameState.getAllMovesForPlayer(gameState.currentPlayer);
-	bool regenerateMoves = depth > 1;
+	if(depth == 1) {
+		// every move leads to exactly one leaf, so there's no need to make them
+		return gameState.countMovesForPlayer(gameState.currentPlayer);
+	}
+	uint64_t nodesSearched = 0;
+	MoveList &moves = moveBuffers[depth];
+	gameState.getAllMovesForPlayer(gameState.currentPlayer, moves);
 	for(uint32_t move : moves) {
-		gameState.makeMove(move, regenerateMoves, true);
+		gameState.makeMove(move, true, true);
 		nodesSearched += perft(gameState, depth - 1);
-		gameState.unmakeMove(regenerateMoves);
+		gameState.unmakeMove();
 	}
 	return nodesSearched;
 }
-// WARNING: This will corrupt the transposition table!! Testing purposes only!
-uint32_t perftTt(GameState &gameState, depth_t depth) {
-	TranspositionTableEntry *ttEntry = transpositionTable.get(gameState.hash);
-	if(ttEntry && ttEntry->depth == 19) return ttEntry->bestMove;
-	
+// Same as perft, but caches node counts in the perft table. Leaves the transposition table untouched.
+MULTIVERSIONED uint64_t perftTt(GameState &gameState, depth_t depth) {
 	if(gameState.royalsLeft[gameState.currentPlayer] == 0) {
-		transpositionTable.put(gameState.hash, 1, 19, 0, 0, NodeType::EXACT);
 		return 1;
 	}
 	if(depth == 0) {
-		transpositionTable.put(gameState.hash, 1, 19, 0, 0, NodeType::EXACT);
 		return 1;
 	}
 	if(gameState.isDraw()) {
-		transpositionTable.put(gameState.hash, 1, 19, 0, 0, NodeType::EXACT);
 		return 1;
 	}
-	uint32_t nodesSearched = 0;
-	std::vector<uint32_t> moves = gameState.getAllMovesForPlayer(gameState.currentPlayer);
-	bool regenerateMoves = depth > 1;
+	if(depth == 1) {
+		return gameState.countMovesForPlayer(gameState.currentPlayer);
+	}
+	if(const PerftTableEntry *perftEntry = perftTable.get(gameState.hash, depth)) {
+		return perftEntry->nodes;
+	}
+	uint64_t nodesSearched = 0;
+	MoveList &moves = moveBuffers[depth];
+	gameState.getAllMovesForPlayer(gameState.currentPlayer, moves);
 	for(uint32_t move : moves) {
-		gameState.makeMove(move, regenerateMoves, true);
+		gameState.makeMove(move, true, true);
 		nodesSearched += perftTt(gameState, depth - 1);
-		gameState.unmakeMove(regenerateMoves);
+		gameState.unmakeMove();
 	}
-	transpositionTable.put(gameState.hash, nodesSearched, 19, 0, 0, NodeType::EXACT);
+	perftTable.put(gameState.hash, depth, nodesSearched);
 	return nodesSearched;
 }
 
+// Times each BoardPosBitset operation on random bitsets with about as many squares as a piece attacks. The operations on two bitsets keep updating the same result, and everything goes into a checksum so that none of it can be optimised out.
+MULTIVERSIONED void benchmarkBitsetOperations(size_t iterations) {
+	constexpr size_t BITSET_COUNT = 256;
+	std::mt19937 rng(1234);
+	std::vector<BoardPosBitset> bitsets(BITSET_COUNT);
+	for(BoardPosBitset &bitset : bitsets) {
+		size_t squareCount = rng() % 40;
+		for(size_t i = 0; i < squareCount; i++) {
+			bitset.insert(static_cast<size_t>(rng() % 1296));
+		}
+	}
+	
+	using clock = std::chrono::steady_clock;
+	auto timeOperation = [&](std::string_view name, auto &&operation) {
+		BoardPosBitset result = bitsets[0];
+		uint64_t checksum = 0;
+		auto start = clock::now();
+		for(size_t i = 0; i < iterations; i++) {
+			checksum += operation(result, bitsets[i % BITSET_COUNT], bitsets[(i * 7 + 3) % BITSET_COUNT]);
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(clock::now() - start);
+		checksum += result.getNonEmptyWords();
+		std::cout << std::format("{:<18} {:.2f} ns (checksum {})", name, elapsed.count() / iterations, checksum) << std::endl;
+	};
+	timeOperation("|=", [](BoardPosBitset &result, const BoardPosBitset &a, const BoardPosBitset &) {
+		result |= a;
+		return 0;
+	});
+	timeOperation("&", [](BoardPosBitset &result, const BoardPosBitset &a, const BoardPosBitset &b) {
+		result ^= a & b;
+		return 0;
+	});
+	timeOperation("^=", [](BoardPosBitset &result, const BoardPosBitset &a, const BoardPosBitset &) {
+		result ^= a;
+		return 0;
+	});
+	timeOperation("eraseAll", [](BoardPosBitset &result, const BoardPosBitset &a, const BoardPosBitset &b) {
+		result |= a;
+		result.eraseAll(b);
+		return 0;
+	});
+	timeOperation("insertAllExcept", [](BoardPosBitset &result, const BoardPosBitset &a, const BoardPosBitset &b) {
+		result.insertAllExcept(a, b);
+		result.eraseAll(b);
+		return 0;
+	});
+	timeOperation("shifted", [](BoardPosBitset &result, const BoardPosBitset &a, const BoardPosBitset &) {
+		// a step up and to the side, and a long way down, like the flood fills do
+		result ^= a.shifted<37>() & a.shifted<-36 * 8>();
+		return 0;
+	});
+	timeOperation("==", [](BoardPosBitset &, const BoardPosBitset &a, const BoardPosBitset &b) {
+		return a == b;
+	});
+	timeOperation("isEmpty", [](BoardPosBitset &, const BoardPosBitset &a, const BoardPosBitset &) {
+		return a.isEmpty();
+	});
+	timeOperation("size", [](BoardPosBitset &, const BoardPosBitset &a, const BoardPosBitset &) {
+		return a.size();
+	});
+	timeOperation("getNonEmptyWords", [](BoardPosBitset &, const BoardPosBitset &a, const BoardPosBitset &) {
+		return a.getNonEmptyWords();
+	});
+	timeOperation("forEach", [](BoardPosBitset &, const BoardPosBitset &a, const BoardPosBitset &) {
+		size_t sum = 0;
+		a.forEach([&](size_t i) {
+			sum += i;
+		});
+		return sum;
+	});
+	std::vector<uint32_t> expanded(1296 + BoardPosBitset::EXPANSION_SLACK);
+	timeOperation("expandInto", [&](BoardPosBitset &, const BoardPosBitset &a, const BoardPosBitset &) {
+		uint32_t *end = a.expandInto(expanded.data(), MOVE_DESTINATIONS, 0, a.getNonEmptyWords());
+		return (end - expanded.data()) + expanded[0];
+	});
+}
+// Compares the two Zobrist key schemes: multiplicative square mixing and the full [species][owner][square] table. Walks a sampled tree from the current position, recording every (piece, square) pair that setSquare/clearSquare would hash and every position reached.
+void benchmarkZobristSchemes(GameState &gameState, depth_t depth, size_t movesPerNode) {
+	struct PositionHashes {
+		hash_t multiplicative;
+		hash_t fullTable;
+		// tells positions apart exactly (for our purposes): the verification keys are unrelated to both schemes and include whether pieces can promote
+		hash_t identity;
+	};
+	std::vector<PositionHashes> positions;
+	std::vector<std::pair<Piece, Vec2>> hashedSquares;
+	std::mt19937 rng(1234);
+	auto visit = [&](auto &visit, depth_t depth) -> void {
+		PositionHashes hashes = { 0, 0, 0 };
+		for(int8_t y = 0; y < 36; y++) {
+			for(int8_t x = 0; x < 36; x++) {
+				Vec2 pos = { x, y };
+				Piece piece = gameState.getSquare(pos);
+				if(piece) {
+					hashes.multiplicative ^= ZobristHashes::getMultiplicativeHash(piece, pos);
+					hashes.fullTable ^= ZobristHashes::getFullTableHash(piece, pos);
+					hashes.identity ^= ZobristHashes::getVerificationHash(piece, pos);
+				}
+			}
+		}
+		if(gameState.currentPlayer) {
+			hashes = { ~hashes.multiplicative, ~hashes.fullTable, ~hashes.identity };
+		}
+		positions.push_back(hashes);
+		if(depth == 0) return;
+		
+		MoveList moves = gameState.getAllMovesForPlayer(gameState.currentPlayer);
+		std::shuffle(moves.begin(), moves.end(), rng);
+		moves.truncate(movesPerNode);
+		bool regenerateMoves = depth > 1;
+		for(uint32_t move : moves) {
+			Vec2 srcPos = getMoveSrcPos(move);
+			Vec2 destPos = getMoveDestPos(move);
+			hashedSquares.push_back({ gameState.getSquare(srcPos), srcPos });
+			hashedSquares.push_back({ gameState.getSquare(srcPos), destPos });
+			if(Piece capturedPiece = gameState.getSquare(destPos); capturedPiece && srcPos != destPos) {
+				hashedSquares.push_back({ capturedPiece, destPos });
+			}
+			gameState.makeMove(move, regenerateMoves, true);
+			visit(visit, depth - 1);
+			gameState.unmakeMove(regenerateMoves);
+		}
+	};
+	visit(visit, depth);
+	
+	// microbenchmark: the same stream of key lookups setSquare/clearSquare would do
+	using clock = std::chrono::steady_clock;
+	constexpr int repetitions = 50;
+	auto timeScheme = [&](auto &&getKey) {
+		hash_t hash = 0;
+		// warm up first, otherwise the full table gets charged for faulting its pages in
+		for(const auto &[piece, pos] : hashedSquares) {
+			hash ^= getKey(piece, pos);
+		}
+		auto start = clock::now();
+		for(int i = 0; i < repetitions; i++) {
+			for(const auto &[piece, pos] : hashedSquares) {
+				hash ^= getKey(piece, pos);
+			}
+			// stop the compiler from hoisting the loop
+			asm volatile("" : "+r"(hash));
+		}
+		auto elapsed = std::chrono::duration<float, std::nano>(clock::now() - start);
+		return elapsed.count() / (hashedSquares.size() * repetitions);
+	};
+	float multiplicativeTime = timeScheme([](Piece piece, Vec2 pos) {
+		return ZobristHashes::getMultiplicativeHash(piece, pos);
+	});
+	float fullTableTime = timeScheme([](Piece piece, Vec2 pos) {
+		return ZobristHashes::getFullTableHash(piece, pos);
+	});
+	
+	// collision test: same scheme hash for different positions
+	auto countCollisions = [&](hash_t PositionHashes::*scheme) {
+		std::unordered_map<hash_t, hash_t> identities;
+		size_t collisions = 0;
+		for(const PositionHashes &hashes : positions) {
+			auto [it, inserted] = identities.try_emplace(hashes.*scheme, hashes.identity);
+			if(!inserted && it->second != hashes.identity) {
+				collisions++;
+			}
+		}
+		return collisions;
+	};
+	// birthday test on the low 32 bits (which decide the transposition table slot), to check the keys are spread evenly
+	std::unordered_map<hash_t, PositionHashes> distinctPositions;
+	for(const PositionHashes &hashes : positions) {
+		distinctPositions.try_emplace(hashes.identity, hashes);
+	}
+	auto countTruncatedCollisions = [&](hash_t PositionHashes::*scheme) {
+		std::unordered_map<uint32_t, size_t> counts;
+		size_t collidingPairs = 0;
+		for(const auto &[identity, hashes] : distinctPositions) {
+			collidingPairs += counts[static_cast<uint32_t>(hashes.*scheme)]++;
+		}
+		return collidingPairs;
+	};
+	double n = distinctPositions.size();
+	double expectedTruncatedCollisions = n * (n - 1) / 2 / 4294967296.0;
+	
+	std::cout << std::format("Visited {} positions ({} distinct), hashed {} squares", positions.size(), distinctPositions.size(), hashedSquares.size()) << std::endl;
+	std::cout << std::format("Multiplicative: {:.3f} ns/key; {} full 64-bit collisions; {} low 32-bit collisions", multiplicativeTime, countCollisions(&PositionHashes::multiplicative), countTruncatedCollisions(&PositionHashes::multiplicative)) << std::endl;
+	std::cout << std::format("Full table:     {:.3f} ns/key; {} full 64-bit collisions; {} low 32-bit collisions", fullTableTime, countCollisions(&PositionHashes::fullTable), countTruncatedCollisions(&PositionHashes::fullTable)) << std::endl;
+	std::cout << std::format("Expected low 32-bit collisions for ideal keys: {:.1f}", expectedTruncatedCollisions) << std::endl;
+}
+
 uint32_t findBestMove(GameState &gameState, depth_t maxDepth, float timeToMove = std::numeric_limits<float>::infinity()) {
 	assert(maxDepth <= MAX_DEPTH);
 	using clock = std::chrono::steady_clock;
@@ -1262,47 +2081,104 @@ uint32_t findBestMove(GameState &gameState, depth_t maxDepth, float timeToMove =
 		}
 	}
 	
-	TranspositionTableEntry* ttEntry = transpositionTable.get(gameState.hash);
+	TranspositionTableEntry* ttEntry = transpositionTable.get(gameState.hash, gameState.getVerificationHash());
 	if(!ttEntry) {
 		std::cout << "log Fatal error: No TT entry found for gameState hash " << gameState.hash << std::endl;
 		throw std::runtime_error("No TT entry found!!!!!!");
 	}
 	return ttEntry->bestMove;
 }
+std::string stringifyTtStats(const TranspositionTableStats &stats) {
+	float hitRate = stats.probes? 100.0f * stats.hits / stats.probes : 0;
+	return std::format("{} probes, {} hits ({:.1f}%), {} usable cutoffs, {} move collisions, {} stores, {} same-age overwrites, {} older-age overwrites, {} rejected stores", stats.probes, stats.hits, hitRate, stats.usableCutoffs, stats.moveCollisions, stats.stores, stats.overwritesSameAge, stats.overwritesOlderAge, stats.rejectedStores);
+}
+// Reports which SIMD instructions are in use: what the whole program was compiled for (which picks BoardPosBitset's intrinsics), and in the portable build, which versions of the hot functions this CPU got
+void outputSimdInfo() {
+	#ifdef __AVX512F__
+		std::string_view compiledFor = "AVX-512";
+	#elif defined(__AVX2__)
+		std::string_view compiledFor = "AVX2";
+	#else
+		std::string_view compiledFor = "no AVX (scalar)";
+	#endif
+	std::cout << "Compiled for: " << compiledFor << std::endl;
+	#if defined(RUNTIME_DISPATCH) && defined(__ELF__)
+		// the same order as the target_clones resolver checks them in
+		__builtin_cpu_init();
+		std::string_view selected = __builtin_cpu_supports("x86-64-v4")? "x86-64-v4 (AVX-512)" : __builtin_cpu_supports("x86-64-v3")? "x86-64-v3 (AVX2)" : "baseline x86-64 (scalar)";
+		std::cout << "Runtime dispatch: using the " << selected << " versions of the hot functions" << std::endl;
+	#else
+		std::cout << "Runtime dispatch: off" << std::endl;
+	#endif
+}
 void outputTtSize() {
 	std::cout << "Transposition table size: " << transpositionTable.size << " / " << TRANSPOSITION_TABLE_SIZE << std::endl;
 }
+void outputTtStats(uint16_t age) {
+	outputTtSize();
+	std::cout << "Hashfull: " << transpositionTable.hashfull(age) << " permille" << std::endl;
+	if constexpr(TRANSPOSITION_TABLE_STATS) {
+		std::cout << "Stats: " << stringifyTtStats(transpositionTable.stats) << std::endl;
+	}
+	#ifdef ZOBRIST_VERIFICATION
+		const TranspositionTableStats &stats = transpositionTable.stats;
+		std::cout << std::format("Hash collisions: {} in the transposition table, {} in repetition detection", stats.hashCollisions, GameState::repetitionHashCollisions) << std::endl;
+		std::cout << std::format("Entries for other positions which would have matched with a truncated key: {} with 16 bits, {} with 32 bits", stats.falseMatches16BitKey, stats.falseMatches32BitKey) << std::endl;
+	#endif
+	std::array<size_t, 256> depthOccupancy = transpositionTable.getDepthOccupancy();
+	for(size_t depth = 0; depth < depthOccupancy.size(); depth++) {
+		if(depthOccupancy[depth]) {
+			std::cout << std::format("Depth {}: {} entries", depth, depthOccupancy[depth]) << std::endl;
+		}
+	}
+}
 void makeBestMove(GameState &gameState) {
 	const float timeToMove = timeIncrement + startingTime / ESTIMATED_GAME_LENGTH;
 	// std::cout << "log Time to move: " << std::to_string(timeToMove) << " seconds" << std::endl;
 	
+	TranspositionTableStats statsBeforeMove = transpositionTable.stats;
+	uint16_t searchAge = gameState.age;
 	uint32_t bestMove = findBestMove(gameState, MAX_DEPTH, timeToMove);
 	std::cout << "move " << stringifyMove(bestMove) << std::endl;
 	gameState.makeMove(bestMove);
 	std::cout << "eval " << gameState.absEval << std::endl;
+	std::cout << "log TT: hashfull " << transpositionTable.hashfull(searchAge) << " permille";
+	if constexpr(TRANSPOSITION_TABLE_STATS) {
+		std::cout << "; " << stringifyTtStats(transpositionTable.stats - statsBeforeMove);
+	}
+	std::cout << std::endl;
 	if(gameState.moveCounter % 100 == 0) {
 		std::cout << "log ";
 		outputTtSize();
 	}
 }
 struct FunctionTiming {
-	uint32_t nodesSearched;
+	uint64_t nodesSearched;
 	std::chrono::milliseconds duration;
 	std::string nodesPerSecond;
 };
 template <std::invocable F>
-requires std::convertible_to<std::invoke_result_t<F>, uint32_t>
+requires std::convertible_to<std::invoke_result_t<F>, uint64_t>
 inline FunctionTiming timeFunction(F func) {
 	using clock = std::chrono::steady_clock;
 	auto start = clock::now();
-	uint32_t nodesSearched = func();
+	#ifdef COUNT_ALLOCATIONS
+		size_t allocationsBefore = allocationCount;
+	#endif
+	uint64_t nodesSearched = func();
 	auto end = clock::now();
 	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+	#ifdef COUNT_ALLOCATIONS
+		size_t allocations = allocationCount - allocationsBefore;
+		std::cout << std::format("{} allocations ({:.4f} per node)", allocations, static_cast<float>(allocations) / nodesSearched) << std::endl;
+	#endif
 	return { nodesSearched, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed), std::format("{} n/s", nodesSearched / (static_cast<float>(elapsed.count()) / 1000000.0f)) };
 }
 
 int main() {
-	GameState gameState = initialGameState;
+	// GameState is far too big for the stack
+	std::unique_ptr<GameState> gameStatePtr = std::make_unique<GameState>(initialGameState);
+	GameState &gameState = *gameStatePtr;
 	
 	std::string line;
 	while(std::getline(std::cin, line)) {
@@ -1350,6 +2226,8 @@ int main() {
 			} else if(command == "win" || command == "loss" || command == "draw") {
 				gameState.logTsfen();
 				std::cout << std::format("log Found {} nodes in total", totalNodesSearched) << std::endl;
+				// so the next game starts warm even if this process gets killed rather than quitting
+				transpositionTable.syncFile();
 			} else if(command == "setparam") {
 				// parameters not yet implemented, this command should never be received
 			} else if(command == "quit") {
@@ -1384,12 +2262,17 @@ int main() {
 					std::cout << "Depth is greater than MAX_DEPTH = " << MAX_DEPTH << "; will only go to depth " << MAX_DEPTH << std::endl;
 					depth = MAX_DEPTH;
 				}
+				perftTable.clear();
 				FunctionTiming timing = timeFunction([&]() {
 					return perftTt(gameState, depth);
 				});
 				std::cout << std::format("Depth {}: Found {} nodes in {} ({})", depth, timing.nodesSearched, timing.duration, timing.nodesPerSecond) << std::endl;
 			} else if(command == "search") {
 				depth_t depth = std::stoi(getItem(arguments, 1));
+				if(depth > MAX_DEPTH) {
+					std::cout << "Depth is greater than MAX_DEPTH = " << MAX_DEPTH << "; will only go to depth " << MAX_DEPTH << std::endl;
+					depth = MAX_DEPTH;
+				}
 				eval_t eval;
 				nodesSearched = 0;
 				FunctionTiming timing = timeFunction([&]() {
@@ -1399,6 +2282,10 @@ int main() {
 				std::cout << std::format("Depth {}: Found {} nodes; Eval = {} in {} ({})", depth, nodesSearched, eval, timing.duration, timing.nodesPerSecond) << std::endl;
 			} else if(command == "bestmove") {
 				depth_t depth = std::stoi(getItem(arguments, 1));
+				if(depth > MAX_DEPTH) {
+					std::cout << "Depth is greater than MAX_DEPTH = " << MAX_DEPTH << "; will only go to depth " << MAX_DEPTH << std::endl;
+					depth = MAX_DEPTH;
+				}
 				nodesSearched = 0;
 				uint32_t bestMove = 0;
 				FunctionTiming timing = timeFunction([&]() {
@@ -1408,8 +2295,190 @@ int main() {
 				gameState.makeMove(bestMove, true, true);
 				std::cout << std::format("Depth {}: Best move = {}; Current eval = {}; found {} nodes in {} ({})", depth, stringifyMove(bestMove), gameState.absEval, nodesSearched, timing.duration, timing.nodesPerSecond) << std::endl;
 				gameState.unmakeMove();
+			} else if(command == "clonebench") {
+				// how long it takes to copy a GameState, both into an existing one (e.g. `gameState = initialGameState`) and into a new one (which includes allocating it)
+				int iterations = arguments.size() > 1? std::stoi(getItem(arguments, 1)) : 1000;
+				using clock = std::chrono::steady_clock;
+				std::unique_ptr<GameState> clone = std::make_unique<GameState>();
+				auto start = clock::now();
+				for(int i = 0; i < iterations; i++) {
+					*clone = gameState;
+					asm volatile("" : : "r"(clone.get()) : "memory");
+				}
+				auto assignElapsed = std::chrono::duration<float, std::micro>(clock::now() - start);
+				start = clock::now();
+				for(int i = 0; i < iterations; i++) {
+					std::unique_ptr<GameState> newClone = std::make_unique<GameState>(gameState);
+					asm volatile("" : : "r"(newClone.get()) : "memory");
+				}
+				auto copyElapsed = std::chrono::duration<float, std::micro>(clock::now() - start);
+				std::cout << std::format("GameState is {} bytes inline. Assigning: {:.2f} us; copy constructing: {:.2f} us", sizeof(GameState), assignElapsed.count() / iterations, copyElapsed.count() / iterations) << std::endl;
+			} else if(command == "makeunmakebench") {
+				// how long making and then unmaking each of the current player's moves takes, the way perft and search do at every node
+				int iterations = arguments.size() > 1? std::stoi(getItem(arguments, 1)) : 100;
+				using clock = std::chrono::steady_clock;
+				MoveList moves = gameState.getAllMovesForPlayer(gameState.currentPlayer);
+				clock::duration makeElapsed{};
+				clock::duration unmakeElapsed{};
+				for(int i = 0; i < iterations; i++) {
+					for(uint32_t move : moves) {
+						auto start = clock::now();
+						gameState.makeMove(move, true, true);
+						auto made = clock::now();
+						gameState.unmakeMove();
+						unmakeElapsed += clock::now() - made;
+						makeElapsed += made - start;
+					}
+				}
+				size_t moveCount = moves.size() * iterations;
+				std::cout << std::format("Made and unmade {} moves. Making: {:.0f} ns; unmaking: {:.0f} ns per move", moves.size(), std::chrono::duration<float, std::nano>(makeElapsed).count() / moveCount, std::chrono::duration<float, std::nano>(unmakeElapsed).count() / moveCount) << std::endl;
+			} else if(command == "evalafterbench") {
+				// how long getting the eval after each of the current player's moves takes, by making and unmaking them vs with evalAfterEach
+				int iterations = arguments.size() > 1? std::stoi(getItem(arguments, 1)) : 100;
+				using clock = std::chrono::steady_clock;
+				MoveList moves = gameState.getAllMovesForPlayer(gameState.currentPlayer);
+				std::vector<eval_t> madeEvals(moves.size());
+				std::vector<eval_t> evalsAfter;
+				auto start = clock::now();
+				for(int i = 0; i < iterations; i++) {
+					for(size_t moveI = 0; moveI < moves.size(); moveI++) {
+						gameState.makeMove(moves[moveI], false, true);
+						madeEvals[moveI] = gameState.royalsLeft[gameState.currentPlayer] == 0? -MAX_EVAL : gameState.eval();
+						gameState.unmakeMove(false);
+					}
+				}
+				auto made = clock::now();
+				for(int i = 0; i < iterations; i++) {
+					gameState.evalAfterEach(moves, evalsAfter);
+				}
+				auto scored = clock::now();
+				if(madeEvals != evalsAfter) {
+					throw std::runtime_error("evalAfterEach doesn't match making the moves!");
+				}
+				size_t moveCount = moves.size() * iterations;
+				std::cout << std::format("Scored {} moves. Making and unmaking: {:.1f} ns; evalAfterEach: {:.1f} ns per move", moves.size(), std::chrono::duration<float, std::nano>(made - start).count() / moveCount, std::chrono::duration<float, std::nano>(scored - made).count() / moveCount) << std::endl;
+			} else if(command == "movegenbench") {
+				// how long it takes to generate the moves of every piece on the board from scratch
+				int iterations = arguments.size() > 1? std::stoi(getItem(arguments, 1)) : 1000;
+				using clock = std::chrono::steady_clock;
+				std::unique_ptr<GameState> clone = std::make_unique<GameState>(gameState);
+				size_t pieceCount = 0;
+				auto start = clock::now();
+				for(int i = 0; i < iterations; i++) {
+					pieceCount = clone->regenerateAllMoves();
+				}
+				auto elapsed = std::chrono::duration<float, std::micro>(clock::now() - start);
+				std::cout << std::format("Generated moves for {} pieces in {:.2f} us ({:.1f} ns per piece)", pieceCount, elapsed.count() / iterations, elapsed.count() * 1000 / iterations / pieceCount) << std::endl;
+			} else if(command == "slideattackbench") {
+				// how long it takes to work out every square each player's slides attack, with flood fills and ray by ray
+				int iterations = arguments.size() > 1? std::stoi(getItem(arguments, 1)) : 1000;
+				using clock = std::chrono::steady_clock;
+				std::unique_ptr<GameState> clone = std::make_unique<GameState>(gameState);
+				for(uint8_t player = 0; player < 2; player++) {
+					BoardPosBitset floodFilled;
+					BoardPosBitset rayByRay;
+					auto start = clock::now();
+					for(int i = 0; i < iterations; i++) {
+						floodFilled = clone->getSlideAttacks(player);
+					}
+					auto floodFillElapsed = std::chrono::duration<float, std::micro>(clock::now() - start);
+					start = clock::now();
+					for(int i = 0; i < iterations; i++) {
+						rayByRay = clone->getSlideAttacksRayByRay(player);
+					}
+					auto rayByRayElapsed = std::chrono::duration<float, std::micro>(clock::now() - start);
+					std::cout << std::format("Player {}: {} squares attacked by slides. Flood fills: {:.2f} us, ray by ray: {:.2f} us{}", player, floodFilled.size(), floodFillElapsed.count() / iterations, rayByRayElapsed.count() / iterations, floodFilled == rayByRay? "" : " (MISMATCH!)") << std::endl;
+				}
+			} else if(command == "movelistbench") {
+				// how long it takes to turn the current player's stored moves into a move list, which search and perft do at every node
+				int iterations = arguments.size() > 1? std::stoi(getItem(arguments, 1)) : 10000;
+				using clock = std::chrono::steady_clock;
+				MoveList moves;
+				auto start = clock::now();
+				for(int i = 0; i < iterations; i++) {
+					gameState.getAllMovesForPlayer(gameState.currentPlayer, moves);
+				}
+				auto elapsed = std::chrono::duration<float, std::micro>(clock::now() - start);
+				std::cout << std::format("Listed {} moves in {:.2f} us ({:.2f} ns per move)", moves.size(), elapsed.count() / iterations, elapsed.count() * 1000 / iterations / moves.size()) << std::endl;
+			} else if(command == "makemode") {
+				// switches search between making and unmaking moves in place and copy-make
+				std::string mode = getItem(arguments, 1);
+				if(mode == "unmake") {
+					useCopyMake = false;
+				} else if(mode == "copy") {
+					useCopyMake = true;
+				} else {
+					std::cerr << "Unknown make mode: " << mode << " (expected unmake or copy)" << std::endl;
+				}
+			} else if(command == "copymakebench") {
+				// searches the current position with make/unmake and then with copy-make, each from an empty transposition table
+				depth_t depth = std::min<depth_t>(std::stoi(getItem(arguments, 1)), MAX_DEPTH);
+				bool wasUsingCopyMake = useCopyMake;
+				// [copyMake]
+				std::array<uint32_t, 2> nodeCounts;
+				std::array<eval_t, 2> evals;
+				for(bool copyMake : { false, true }) {
+					useCopyMake = copyMake;
+					transpositionTable.clear();
+					killerMoves = {};
+					nodesSearched = 0;
+					eval_t eval;
+					FunctionTiming timing = timeFunction([&]() {
+						eval = search(gameState, -MAX_EVAL, MAX_EVAL, depth);
+						return nodesSearched;
+					});
+					std::cout << std::format("{}: Found {} nodes; Eval = {} in {} ({})", copyMake? "Copy-make" : "Make/unmake", nodesSearched, eval, timing.duration, timing.nodesPerSecond) << std::endl;
+					nodeCounts[copyMake] = nodesSearched;
+					evals[copyMake] = eval;
+				}
+				useCopyMake = wasUsingCopyMake;
+				// they should be searching exactly the same tree, so otherwise the timings aren't comparable
+				if(nodeCounts[0] != nodeCounts[1] || evals[0] != evals[1]) {
+					std::cout << "Copy-make searched a different tree to make/unmake (MISMATCH!)" << std::endl;
+				}
+			#ifdef SPECIES_MOVE_GENERATORS
+			} else if(command == "movegen") {
+				// switches between the move generators compiled for each species and the interpreter, e.g. to compare them with perft or movegenbench
+				std::string mode = getItem(arguments, 1);
+				if(mode == "templated") {
+					useSpeciesMoveGenerators = true;
+				} else if(mode == "interpreted") {
+					useSpeciesMoveGenerators = false;
+				} else {
+					std::cerr << "Unknown move generator: " << mode << " (expected templated or interpreted)" << std::endl;
+				}
+			#endif
+			} else if(command == "bitsetbench") {
+				size_t iterations = arguments.size() > 1? std::stoull(getItem(arguments, 1)) : 10000000;
+				benchmarkBitsetOperations(iterations);
+			} else if(command == "zobristbench") {
+				depth_t depth = arguments.size() > 1? std::stoi(getItem(arguments, 1)) : 3;
+				size_t movesPerNode = arguments.size() > 2? std::stoi(getItem(arguments, 2)) : 60;
+				benchmarkZobristSchemes(gameState, std::min(depth, MAX_DEPTH), movesPerNode);
+			} else if(command == "simd") {
+				outputSimdInfo();
 			} else if(command == "ttsize") {
-				outputTtSize();
+				outputTtStats(gameState.age);
+			} else if(command == "ttfile") {
+				std::string path = textAfter(line, " ");
+				if(path.empty()) {
+					transpositionTable.closeFile();
+					transpositionTable.clear();
+					std::cout << "Transposition table is now in memory only" << std::endl;
+					continue;
+				}
+				switch(transpositionTable.openFile(path, ZobristHashes::KEY_SET_ID)) {
+					case TranspositionTableFileStatus::LOADED:
+						std::cout << "Loaded transposition table from " << path << std::endl;
+						outputTtSize();
+						break;
+					case TranspositionTableFileStatus::CREATED:
+						std::cout << "Created new transposition table in " << path << std::endl;
+						break;
+					case TranspositionTableFileStatus::UNAVAILABLE:
+						std::cout << "Couldn't open " << path << "; transposition table is in memory only" << std::endl;
+						break;
+				}
 			} else if(command == "pieces") {
 				for(size_t i = 0; i < PieceTable.size(); i++) {
 					std::cout << std::format("{}: {}; value: {}; promotion: {}", i, PieceTable[i].name, basePieceValues[i], PieceTable[PieceTable[i].promotion].name) << std::endl;
@@ -1,12 +1,31 @@
 #pragma once
 
 #include <cstdint>
+#include <algorithm>
 #include <array>
+#include <string>
+#include <bit>
+
+#ifdef _WIN32
+	#define WIN32_LEAN_AND_MEAN
+	#define NOMINMAX
+	#define NOGDI
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 // How many bits the transposition table keys should be.
 constexpr inline uint32_t TRANSPOSITION_TABLE_BITS = 22;
 constexpr inline uint32_t TRANSPOSITION_TABLE_SIZE = 1u << TRANSPOSITION_TABLE_BITS;
 constexpr inline hash_t HASH_MASK = (1 << TRANSPOSITION_TABLE_BITS) - 1;
+// Whether to count probes, hits, overwrites etc. Turn off to compile the counters out entirely.
+constexpr inline bool TRANSPOSITION_TABLE_STATS = true;
+// Bump this whenever the layout of TranspositionTableEntry or the file header changes, so old files get thrown away instead of being misread.
+constexpr inline uint32_t TRANSPOSITION_TABLE_FILE_VERSION = 1;
 
 enum class NodeType {
 	EXACT,
@@ -22,28 +41,291 @@ struct TranspositionTableEntry {
 	uint16_t age;
 	eval_t eval;
 	NodeType nodeType;
+	#ifdef ZOBRIST_VERIFICATION
+		hash_t verificationHash;
+	#endif
+};
+
+struct TranspositionTableStats {
+	uint64_t probes = 0;
+	uint64_t hits = 0;
+	// hits deep enough, and with the right bound, that the search could cut off straight away
+	uint64_t usableCutoffs = 0;
+	// hits whose best move wasn't a legal move in the position, i.e. the entry is for a different position with the same hash
+	uint64_t moveCollisions = 0;
+	uint64_t stores = 0;
+	// stores which replaced an entry for a different position from the same game age, i.e. possibly useful information was thrown away
+	uint64_t overwritesSameAge = 0;
+	// stores which replaced an entry from an earlier game age
+	uint64_t overwritesOlderAge = 0;
+	// stores which didn't happen because the existing entry was deeper
+	uint64_t rejectedStores = 0;
+	// The following are only counted in ZOBRIST_VERIFICATION builds.
+	// probes which matched the hash but not the verification hash - these are real collisions, and aren't returned as hits
+	uint64_t hashCollisions = 0;
+	// probes which found an entry for a different position that would still have matched if only the top 16/32 bits of the hash were stored
+	uint64_t falseMatches16BitKey = 0;
+	uint64_t falseMatches32BitKey = 0;
+	
+	TranspositionTableStats operator-(const TranspositionTableStats &other) const {
+		return { probes - other.probes, hits - other.hits, usableCutoffs - other.usableCutoffs, moveCollisions - other.moveCollisions, stores - other.stores, overwritesSameAge - other.overwritesSameAge, overwritesOlderAge - other.overwritesOlderAge, rejectedStores - other.rejectedStores, hashCollisions - other.hashCollisions, falseMatches16BitKey - other.falseMatches16BitKey, falseMatches32BitKey - other.falseMatches32BitKey };
+	}
+};
+
+// Sits at the start of a transposition table file, followed directly by the entries. Padded to a cache line so the entries stay aligned.
+struct alignas(64) TranspositionTableFileHeader {
+	std::array<char, 8> magic;
+	uint32_t version;
+	uint32_t entrySize;
+	uint32_t tableBits;
+	// Set while the file is mapped and cleared once the checksum has been written, so a crash mid-game is detected as a dirty file.
+	uint32_t dirty;
+	// Identifies the Zobrist keys the hashes in the file were made with - entries are useless if the keys have changed.
+	hash_t zobristKeySetId;
+	uint64_t checksum;
+	uint64_t size;
+};
+constexpr inline std::array<char, 8> TRANSPOSITION_TABLE_FILE_MAGIC = { 'T', 'O', 'M', 'A', 'T', 'T', 'T', '\0' };
+
+enum class TranspositionTableFileStatus {
+	LOADED,
+	CREATED,
+	UNAVAILABLE
 };
 
 class TranspositionTable {
 private:
-	std::array<TranspositionTableEntry, TRANSPOSITION_TABLE_SIZE>table{};
+	// only actually touched when the table isn't backed by a file, so it costs nothing otherwise
+	std::array<TranspositionTableEntry, TRANSPOSITION_TABLE_SIZE> inMemoryTable{};
+	TranspositionTableEntry* table = inMemoryTable.data();
+	TranspositionTableFileHeader* fileHeader = nullptr;
+	#ifdef _WIN32
+		HANDLE fileHandle = INVALID_HANDLE_VALUE;
+		HANDLE fileMappingHandle = nullptr;
+	#endif
+
+	static constexpr size_t FILE_SIZE = sizeof(TranspositionTableFileHeader) + sizeof(TranspositionTableEntry) * TRANSPOSITION_TABLE_SIZE;
+
+	uint64_t calculateChecksum() const {
+		// a word at a time, otherwise this takes far too long for a 100 MB table
+		const uint64_t* words = reinterpret_cast<const uint64_t*>(table);
+		size_t wordCount = sizeof(TranspositionTableEntry) * TRANSPOSITION_TABLE_SIZE / sizeof(uint64_t);
+		uint64_t checksum = 0xCBF29CE484222325ULL;
+		for(size_t i = 0; i < wordCount; i++) {
+			checksum = std::rotl((checksum ^ words[i]) * 0x100000001B3ULL, 29);
+		}
+		return checksum;
+	}
+	bool mapFile(const std::string &path) {
+		#ifdef _WIN32
+			fileHandle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if(fileHandle == INVALID_HANDLE_VALUE) {
+				return false;
+			}
+			fileMappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE, static_cast<DWORD>(FILE_SIZE >> 32), static_cast<DWORD>(FILE_SIZE), nullptr);
+			if(!fileMappingHandle) {
+				CloseHandle(fileHandle);
+				fileHandle = INVALID_HANDLE_VALUE;
+				return false;
+			}
+			void* mapping = MapViewOfFile(fileMappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, FILE_SIZE);
+			if(!mapping) {
+				CloseHandle(fileMappingHandle);
+				CloseHandle(fileHandle);
+				fileMappingHandle = nullptr;
+				fileHandle = INVALID_HANDLE_VALUE;
+				return false;
+			}
+		#else
+			int fd = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+			if(fd < 0) {
+				return false;
+			}
+			struct stat fileStat;
+			if(fstat(fd, &fileStat) || (static_cast<size_t>(fileStat.st_size) != FILE_SIZE && ftruncate(fd, FILE_SIZE))) {
+				close(fd);
+				return false;
+			}
+			void* mapping = mmap(nullptr, FILE_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+			// the mapping keeps the file open by itself
+			close(fd);
+			if(mapping == MAP_FAILED) {
+				return false;
+			}
+		#endif
+		fileHeader = static_cast<TranspositionTableFileHeader*>(mapping);
+		table = reinterpret_cast<TranspositionTableEntry*>(fileHeader + 1);
+		return true;
+	}
+	void unmapFile() {
+		#ifdef _WIN32
+			UnmapViewOfFile(fileHeader);
+			CloseHandle(fileMappingHandle);
+			CloseHandle(fileHandle);
+			fileMappingHandle = nullptr;
+			fileHandle = INVALID_HANDLE_VALUE;
+		#else
+			munmap(fileHeader, FILE_SIZE);
+		#endif
+		fileHeader = nullptr;
+		table = inMemoryTable.data();
+	}
+	void flushFile() {
+		fileHeader->size = size;
+		fileHeader->checksum = calculateChecksum();
+		fileHeader->dirty = 0;
+		#ifdef _WIN32
+			FlushViewOfFile(fileHeader, FILE_SIZE);
+		#else
+			msync(fileHeader, FILE_SIZE, MS_SYNC);
+		#endif
+	}
 public:
 	size_t size = 0;
-	TranspositionTableEntry* get(hash_t hash) {
+	TranspositionTableStats stats;
+
+	TranspositionTable() = default;
+	TranspositionTable(const TranspositionTable&) = delete;
+	TranspositionTable& operator=(const TranspositionTable&) = delete;
+	~TranspositionTable() {
+		// not closeFile, since there's no need to clear the in-memory table on the way out
+		if(fileHeader) {
+			flushFile();
+			unmapFile();
+		}
+	}
+
+	// verificationHash is only used in ZOBRIST_VERIFICATION builds
+	TranspositionTableEntry* get(hash_t hash, [[maybe_unused]] hash_t verificationHash) {
 		hash_t maskedHash = hash & HASH_MASK;
 		TranspositionTableEntry& entry = table[maskedHash];
+		if constexpr(TRANSPOSITION_TABLE_STATS) {
+			stats.probes++;
+		}
+		#ifdef ZOBRIST_VERIFICATION
+			if(entry.bestMove && entry.verificationHash != verificationHash) {
+				if(entry.hash == hash) {
+					stats.hashCollisions++;
+					return nullptr;
+				}
+				hash_t keyDifference = entry.hash ^ hash;
+				if(!(keyDifference >> 48)) {
+					stats.falseMatches16BitKey++;
+				}
+				if(!(keyDifference >> 32)) {
+					stats.falseMatches32BitKey++;
+				}
+			}
+		#endif
 		if(entry.hash == hash) {
+			if constexpr(TRANSPOSITION_TABLE_STATS) {
+				stats.hits++;
+			}
 			return &entry;
 		}
 		return nullptr;
 	}
-	void put(hash_t hash, uint32_t bestMove, depth_t depth, uint16_t age, eval_t eval, NodeType nodeType) {
+	void put(hash_t hash, [[maybe_unused]] hash_t verificationHash, uint32_t bestMove, depth_t depth, uint16_t age, eval_t eval, NodeType nodeType) {
 		hash_t maskedHash = hash & HASH_MASK;
-		if(table[maskedHash].bestMove == 0) { // this will detect new entries - a best move will never be 0
+		TranspositionTableEntry &entry = table[maskedHash];
+		bool isNewEntry = entry.bestMove == 0; // this will detect new entries - a best move will never be 0
+		if(isNewEntry) {
 			size++;
 		}
-		if(depth >= table[maskedHash].depth || age != table[maskedHash].age) {
-			table[maskedHash] = { hash, bestMove, depth, age, eval, nodeType };
+		if(depth >= entry.depth || age != entry.age) {
+			if constexpr(TRANSPOSITION_TABLE_STATS) {
+				stats.stores++;
+				if(!isNewEntry && entry.hash != hash) {
+					if(entry.age == age) {
+						stats.overwritesSameAge++;
+					} else {
+						stats.overwritesOlderAge++;
+					}
+				}
+			}
+			#ifdef ZOBRIST_VERIFICATION
+				entry = { hash, bestMove, depth, age, eval, nodeType, verificationHash };
+			#else
+				entry = { hash, bestMove, depth, age, eval, nodeType };
+			#endif
+		} else if constexpr(TRANSPOSITION_TABLE_STATS) {
+			stats.rejectedStores++;
+		}
+	}
+	// Checks whether an entry would let the search return straight away. The search doesn't actually do this yet, but it's useful to know how often it could.
+	void recordProbeResult(const TranspositionTableEntry &entry, depth_t depth, eval_t alpha, eval_t beta) {
+		if constexpr(TRANSPOSITION_TABLE_STATS) {
+			if(entry.depth >= depth && (entry.nodeType == NodeType::EXACT || (entry.nodeType == NodeType::LOWER_BOUND && entry.eval >= beta) || (entry.nodeType == NodeType::UPPER_BOUND && entry.eval <= alpha))) {
+				stats.usableCutoffs++;
+			}
+		}
+	}
+	void recordMoveCollision() {
+		if constexpr(TRANSPOSITION_TABLE_STATS) {
+			stats.moveCollisions++;
+		}
+	}
+	// How full the table is in permille, only counting entries from the current game age. Like UCI's hashfull, this only samples the first 1000 entries.
+	uint32_t hashfull(uint16_t age) const {
+		uint32_t count = 0;
+		for(size_t i = 0; i < 1000; i++) {
+			if(table[i].bestMove && table[i].age == age) {
+				count++;
+			}
+		}
+		return count;
+	}
+	// Counts entries at each depth by scanning the whole table. Too slow to do every move, but fine on request.
+	std::array<size_t, 256> getDepthOccupancy() const {
+		std::array<size_t, 256> occupancy{};
+		for(size_t i = 0; i < TRANSPOSITION_TABLE_SIZE; i++) {
+			if(table[i].bestMove) {
+				occupancy[table[i].depth]++;
+			}
+		}
+		return occupancy;
+	}
+	void clear() {
+		std::fill_n(table, TRANSPOSITION_TABLE_SIZE, TranspositionTableEntry{});
+		size = 0;
+	}
+
+	// Backs the table with a memory-mapped file so it survives between runs. If the file holds a valid table made with the same Zobrist keys it is loaded as is, otherwise it's (re)initialised.
+	TranspositionTableFileStatus openFile(const std::string &path, hash_t zobristKeySetId) {
+		closeFile();
+		if(!mapFile(path)) {
+			// falls back to the in-memory table, which mustn't keep entries from before (possibly hashed with other keys)
+			clear();
+			return TranspositionTableFileStatus::UNAVAILABLE;
+		}
+		TranspositionTableFileHeader &header = *fileHeader;
+		bool isValid = header.magic == TRANSPOSITION_TABLE_FILE_MAGIC && header.version == TRANSPOSITION_TABLE_FILE_VERSION && header.entrySize == sizeof(TranspositionTableEntry) && header.tableBits == TRANSPOSITION_TABLE_BITS && header.zobristKeySetId == zobristKeySetId && !header.dirty && header.checksum == calculateChecksum();
+		TranspositionTableFileStatus status;
+		if(isValid) {
+			size = header.size;
+			status = TranspositionTableFileStatus::LOADED;
+		} else {
+			header = TranspositionTableFileHeader{ TRANSPOSITION_TABLE_FILE_MAGIC, TRANSPOSITION_TABLE_FILE_VERSION, sizeof(TranspositionTableEntry), TRANSPOSITION_TABLE_BITS, 0, zobristKeySetId, 0, 0 };
+			clear();
+			status = TranspositionTableFileStatus::CREATED;
 		}
+		header.dirty = 1;
+		return status;
 	}
-};
\ No newline at end of file
+	// Writes the checksum and flushes the file. The table stays mapped and usable afterwards.
+	void syncFile() {
+		if(!fileHeader) return;
+		flushFile();
+		fileHeader->dirty = 1;
+	}
+	void closeFile() {
+		if(!fileHeader) return;
+		flushFile();
+		unmapFile();
+		// the in-memory table may still have entries from before the file was opened, possibly hashed with other keys
+		clear();
+	}
+	bool isFileBacked() const {
+		return fileHeader;
+	}
+};
@@ -3,6 +3,7 @@
 
 #pragma once
 #include <array>
+#include <bit>
 #include <cstdint>
 
 namespace ZobristHashes {
@@ -314,9 +315,61 @@ namespace ZobristHashes {
 		};
 	}
 	
-	constexpr inline hash_t getHash(Piece piece, Vec2 pos) {
-		// The magic number belo ws chosen as it leads to an average Hamming distance of 32.02458 bits between other position hashes. Less memory than a full table, but I'd have to verify sometime if it actually impacts performance.
-		hash_t hash = PieceHashes[piece.getSpecies()] ^ ((static_cast<hash_t>(pos.x) * 36 + static_cast<hash_t>(pos.y)) * 0x5C1B4D72E2FFCD75ULL);
+	// The magic number below was chosen as it leads to an average Hamming distance of 32.02458 bits between other position hashes.
+	constexpr inline hash_t SQUARE_MULTIPLIER = 0x5C1B4D72E2FFCD75ULL;
+	
+	// [species][owner][square]. zobristFullTable.inc is generated by the Makefile with `scripts/generate64BitZobristKeys.cpp full`; at ~18 MB it isn't checked in.
+	inline constexpr std::array<std::array<std::array<hash_t, 1296>, 2>, 302> FullTable = {{
+		#include "zobristFullTable.inc"
+	}};
+	
+	// Identifies the current set of keys, so hashes saved somewhere (e.g. a transposition table file) can be discarded when the keys change.
+	constexpr inline hash_t KEY_SET_ID = [] {
+		hash_t id = SQUARE_MULTIPLIER;
+		for(hash_t pieceHash : PieceHashes) {
+			id = std::rotl(id ^ pieceHash, 23) * 0x9E3779B97F4A7C15ULL;
+		}
+		// the whole table takes too long to fold at compile time, but regenerating it changes every key anyway
+		for(const auto &ownerKeys : FullTable) {
+			for(const auto &squareKeys : ownerKeys) {
+				id = std::rotl(id ^ squareKeys.front() ^ squareKeys.back(), 23) * 0x9E3779B97F4A7C15ULL;
+			}
+		}
+		#ifdef ZOBRIST_MULTIPLICATIVE_HASH
+			id = ~id;
+		#endif
+		return id;
+	}();
+	
+	constexpr inline hash_t splitmix64(hash_t z) {
+		z = z * 0x9E3779B97F4A7C15ULL + 0xD1B54A32D192ED03ULL;
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+		return z ^ (z >> 31);
+	}
+	
+	// Looks up an independent key for every species, owner and square in the full table
+	constexpr inline hash_t getFullTableHash(Piece piece, Vec2 pos) {
+		return FullTable[piece.getSpecies()][piece.getOwner()][pos.toIndex()];
+	}
+	// Mixes the square into the piece's key with a multiply rather than looking it up in the full table. This only needs 2.4 KB of keys rather than 6 MB.
+	// However the piece key and square term are XORed independently, so the hash only depends on which species are present and which squares are occupied, not which piece is on which square. This causes real collisions (see `zobristbench`).
+	constexpr inline hash_t getMultiplicativeHash(Piece piece, Vec2 pos) {
+		hash_t hash = PieceHashes[piece.getSpecies()] ^ ((static_cast<hash_t>(pos.x) * 36 + static_cast<hash_t>(pos.y)) * SQUARE_MULTIPLIER);
 		return piece.getOwner()? std::rotr(hash, 32) : hash;
 	}
+	
+	// `zobristbench` compares both schemes. The full table is the default because it doesn't collide, not for speed: its keys are a little slower to get than multiplying, and perft runs about as fast with either. Build with -DZOBRIST_MULTIPLICATIVE_HASH to go back to multiplicative mixing.
+	constexpr inline hash_t getHash(Piece piece, Vec2 pos) {
+		#ifdef ZOBRIST_MULTIPLICATIVE_HASH
+			return getMultiplicativeHash(piece, pos);
+		#else
+			return getFullTableHash(piece, pos);
+		#endif
+	}
+	
+	// A second key stream, used by verification builds to detect collisions in getHash, and by `zobristbench` to tell positions apart. It's a splitmix64 of the whole piece and square so it doesn't share any structure with getHash, and unlike getHash it also tells apart pieces that can and can't promote.
+	inline hash_t getVerificationHash(Piece piece, Vec2 pos) {
+		return splitmix64(static_cast<hash_t>(piece.getSpecies()) << 13 | static_cast<hash_t>(piece.getOwner()) << 12 | static_cast<hash_t>(piece.canPromote()) << 11 | pos.toIndex());
+	}
 };
\ No newline at end of file